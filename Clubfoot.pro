@@ -24,6 +24,7 @@ include(gitrev.pri)
 SOURCES += \
     src/ClubFoot.cpp \
     src/HashTable.cpp \
+    src/Material.cpp \
     src/Stats.cpp \
     src/main.cpp \
     senjo/src/BackgroundCommand.cpp \
@@ -36,6 +37,7 @@ SOURCES += \
 
 HEADERS += \
     src/ClubFoot.h \
+    src/Material.h \
     src/Move.h \
     src/Stats.h \
     src/Types.h \
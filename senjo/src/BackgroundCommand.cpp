@@ -440,16 +440,18 @@ bool TestCommandHandle::Parse(const char* params)
   static const std::string argNoClear = "noclear";
   static const std::string argPrint   = "print";
   static const std::string argSkip    = "skip";
+  static const std::string argThreads = "threads";
   static const std::string argTime    = "time";
 
-  noClear    = false;
-  printBoard = false;
-  maxCount   = 0;
-  maxDepth   = 0;
-  minGain    = 0;
-  skipCount  = 0;
-  maxTime    = 0;
-  fileName   = "";
+  noClear     = false;
+  printBoard  = false;
+  maxCount    = 0;
+  maxDepth    = 0;
+  minGain     = 0;
+  skipCount   = 0;
+  threadCount = 1;
+  maxTime     = 0;
+  fileName    = "";
 
   bool invalid = false;
   while (!invalid && params && *NextWord(params)) {
@@ -459,6 +461,7 @@ bool TestCommandHandle::Parse(const char* params)
         NumberParam(argDepth, maxDepth,   params, invalid) ||
         NumberParam(argGain,  minGain,    params, invalid) ||
         NumberParam(argSkip,  skipCount,  params, invalid) ||
+        NumberParam(argThreads, threadCount, params, invalid) ||
         NumberParam(argTime,  maxTime,    params, invalid) ||
         StringParam(argFile,  fileName,   params, invalid))
     {
@@ -492,30 +495,25 @@ void TestCommandHandle::Execute()
     return;
   }
 
-  char     fen[16384];
-  int      depth = 0;
-  int      line = 0;
-  int      maxSearchDepth = 0;
-  int      maxSeldepth = 0;
-  int      minSearchDepth = -1;
-  int      minSeldepth = -1;
-  int      passed = 0;
-  int      positions = 0;
-  int      seldepth = 0;
-  int      tested = 0;
-  int      totalDepth = 0;
-  int      totalSeldepth = 0;
-  uint64_t nodes = 0;
-  uint64_t qnodes = 0;
-  uint64_t time = 0;
-  uint64_t totalNodes = 0;
-  uint64_t totalQnodes = 0;
-  uint64_t totalTime = 0;
-  FILE*    fp = NULL;
+  positions.clear();
+  nextPosition   = 0;
+  nextReport     = 0;
+  workersDone    = 0;
+  maxSearchDepth = 0;
+  maxSeldepth    = 0;
+  minSearchDepth = -1;
+  minSeldepth    = -1;
+  passed         = 0;
+  tested         = 0;
+  totalDepth     = 0;
+  totalSeldepth  = 0;
+  totalNodes     = 0;
+  totalQnodes    = 0;
+  totalTime      = 0;
 
-  try {
-    MoveFinder moveFinder;
+  FILE* fp = NULL;
 
+  try {
     if (!(fp = fopen(fileName.c_str(), "r"))) {
       Output() << "Cannot open '" << fileName << "': " << strerror(errno);
       return;
@@ -524,140 +522,447 @@ void TestCommandHandle::Execute()
     engine->ClearStopFlags();
     engine->ResetStatsTotals();
 
-    while (fgets(fen, sizeof(fen), fp)) {
-      line++;
+    LoadPositions(fp);
+    fclose(fp);
+    fp = NULL;
 
-      char* f = fen;
-      if (!*NextWord(f) || (*f == '#')) {
-        continue;
-      }
+    const uint64_t start = Now();
+    if (threadCount > 1) {
+      RunParallel();
+    }
+    else {
+      RunSerial();
+    }
+    const uint64_t wallTime = (Now() - start);
 
-      positions++;
-      if (skipCount && (positions <= skipCount)) {
-        continue;
-      }
+    Output() << "--- Completed " << tested << " test positions";
+    Output() << "--- Passed    " << passed << " passed ("
+             << Percent(passed, tested) << "%)";
+    Output() << "--- Time      " << totalTime << " ("
+             << Average(totalTime, static_cast<uint64_t>(tested)) << " avg)";
+    Output() << "--- Nodes     " << totalNodes << ", "
+             << Rate((totalNodes / 1000), totalTime) << " KNodes/sec";
+    if (threadCount > 1) {
+      // the times above are summed over positions searched at the same time
+      Output() << "--- Wall Time " << wallTime << " with " << threadCount
+               << " threads, " << Rate((totalNodes / 1000), wallTime)
+               << " KNodes/sec aggregate";
+    }
+    Output() << "--- QNodes    " << totalQnodes << " ("
+             << Percent(totalQnodes, totalNodes) << "%)";
+    Output() << "--- Depth     " << minSearchDepth << " min, "
+             << static_cast<int>(Average(totalDepth, tested)) << " avg, "
+             << maxSearchDepth << " max";
+    Output() << "--- SelDepth  " << minSeldepth << " min, "
+             << static_cast<int>(Average(totalSeldepth, tested)) << " avg, "
+             << maxSeldepth << " max";
 
-      Output() << "--- Test " << (++tested) << " at line " << line << ' ' << f;
-      NormalizeString(f);
-      const char* next = engine->SetPosition(f);
-      if (!next || !moveFinder.LoadFEN(f)) {
-        break;
-      }
-      f += (next - f);
+    engine->ShowStatsTotals();
+  }
+  catch (const std::exception& e) {
+    Output() << "ERROR: " << e.what();
+  }
+  catch (...) {
+    Output() << "Unknown error!";
+  }
 
-      // consume 'am' and 'bm' parameters
-      std::set<std::string> avoid;
-      std::set<std::string> best;
-      while (f && *NextWord(f)) {
-        // null terminate this parameter (parameters end with ; or end of line)
-        char* end = strchr(f, ';');
-        if (end) {
-          *end = 0;
-        }
+  if (fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::LoadPositions(FILE* fp)
+{
+  char       fen[16384];
+  int        line = 0;
+  int        count = 0;
+  MoveFinder moveFinder;
+
+  while (fgets(fen, sizeof(fen), fp)) {
+    line++;
+
+    char* f = fen;
+    if (!*NextWord(f) || (*f == '#')) {
+      continue;
+    }
+
+    count++;
+    if (skipCount && (count <= skipCount)) {
+      continue;
+    }
+
+    TestPosition pos;
+    pos.line = line;
+    pos.text = f;
+    NormalizeString(f);
+    const char* next = engine->SetPosition(f);
+    if (!next || !moveFinder.LoadFEN(f)) {
+      return;
+    }
+    pos.fen.assign(f, (next - f));
+    f += (next - f);
+
+    // consume 'am' and 'bm' parameters
+    while (f && *NextWord(f)) {
+      // null terminate this parameter (parameters end with ; or end of line)
+      char* end = strchr(f, ';');
+      if (end) {
+        *end = 0;
+      }
 
-        if (!strncmp(f, "am ", 3)) {
-          f += 3;
-          while (*NextWord(f)) {
-            std::string coord = moveFinder.ToCoordinates(f);
-            if (coord.size()) {
-              avoid.insert(coord);
-            }
-            else {
-              break;
-            }
+      if (!strncmp(f, "am ", 3)) {
+        f += 3;
+        while (*NextWord(f)) {
+          std::string coord = moveFinder.ToCoordinates(f);
+          if (coord.size()) {
+            pos.avoid.insert(coord);
           }
-        }
-        else if (!strncmp(f, "bm ", 3)) {
-          f += 3;
-          while (*NextWord(f)) {
-            std::string coord = moveFinder.ToCoordinates(f);
-            if (coord.size()) {
-              best.insert(coord);
-            }
-            else {
-              break;
-            }
+          else {
+            break;
           }
         }
-
-        // move 'f' to beginning of next parameter
-        if (end) {
-          f = (end + 1);
-          continue;
+      }
+      else if (!strncmp(f, "bm ", 3)) {
+        f += 3;
+        while (*NextWord(f)) {
+          std::string coord = moveFinder.ToCoordinates(f);
+          if (coord.size()) {
+            pos.best.insert(coord);
+          }
+          else {
+            break;
+          }
         }
-        break;
       }
 
-      if (avoid.empty() && best.empty()) {
-        Output() << "error at line " << line
-                 << ", no best or avoid moves specified";
-        break;
+      // move 'f' to beginning of next parameter
+      if (end) {
+        f = (end + 1);
+        continue;
       }
+      break;
+    }
 
-      if (!noClear) {
-        engine->ClearSearchData();
-      }
-      if (printBoard) {
-        engine->PrintBoard();
-      }
+    if (pos.avoid.empty() && pos.best.empty()) {
+      Output() << "error at line " << line
+               << ", no best or avoid moves specified";
+      return;
+    }
 
-      const std::string bestmove = engine->Go(maxDepth, 0, maxTime);
-      Output(Output::NoPrefix) << "bestmove " << bestmove;
+    pos.tail     = f;
+    pos.depth    = 0;
+    pos.seldepth = 0;
+    pos.nodes    = 0;
+    pos.qnodes   = 0;
+    pos.time     = 0;
+    pos.done     = false;
+    positions.push_back(pos);
 
-      engine->GetStats(&depth, &seldepth, &nodes, &qnodes, &time);
-      if (bestmove.empty() ||
-          (best.size() && !best.count(bestmove)) ||
-          (avoid.size() && avoid.count(bestmove)))
-      {
-        Output() << "--- FAILED! line " << line << " ("
-                 << Percent(passed, tested) << "%) " << f;
+    if (maxCount && (static_cast<int>(positions.size()) >= maxCount)) {
+      break;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::RunSerial()
+{
+  for (size_t i = 0; i < positions.size(); ++i) {
+    TestPosition& pos = positions[i];
+    Output() << "--- Test " << (tested + 1) << " at line " << pos.line << ' '
+             << pos.text;
+    if (!engine->SetPosition(pos.fen.c_str())) {
+      break;
+    }
+    if (printBoard) {
+      engine->PrintBoard();
+    }
+
+    Search(*engine, pos);
+    Output(Output::NoPrefix) << "bestmove " << pos.bestmove;
+    Report(pos);
+
+    if (engine->StopRequested()) {
+      break;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::RunParallel()
+{
+  std::vector<Worker*> workers;
+  for (int i = 0; i < threadCount; ++i) {
+    ChessEngine* worker = engine->CreateWorker();
+    if (!worker) {
+      break;
+    }
+    worker->SetQuiet(true);
+    workers.push_back(new Worker);
+    workers.back()->handle = this;
+    workers.back()->engine = worker;
+  }
+
+  if (workers.size() < 2) {
+    Output() << "Engine does not support parallel tests, running serially";
+  }
+  else {
+    Output() << "--- Testing with " << workers.size() << " worker engines";
+    size_t started = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+      if (workers[i]->thread.Start(WorkerSearch, workers[i])) {
+        started++;
       }
       else {
-        passed++;
-        Output() << "--- Passed. line " << line << " ("
-                 << Percent(passed, tested) << "%) " << f;
+        Output() << "Failed to start test worker thread!";
       }
+    }
 
-      if (depth > maxSearchDepth) {
-        maxSearchDepth = depth;
-      }
-      if ((minSearchDepth < 0) || (depth < minSearchDepth)) {
-        minSearchDepth = depth;
+    // pass stop requests on to the workers until they're all done
+    bool stopped = false;
+    while (true) {
+      mutex.Lock();
+      const bool done = (workersDone >= started);
+      mutex.Unlock();
+      if (done) {
+        break;
       }
-      if (seldepth > maxSeldepth) {
-        maxSeldepth = seldepth;
+      if (!stopped && engine->StopRequested()) {
+        stopped = true;
+        for (size_t i = 0; i < workers.size(); ++i) {
+          workers[i]->engine->Stop(ChessEngine::FullStop);
+        }
       }
-      if ((minSeldepth < 0) || (seldepth < minSeldepth)) {
-        minSeldepth = seldepth;
+      MillisecondSleep(10);
+    }
+  }
+
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i]->thread.Join();
+    delete workers[i]->engine;
+    delete workers[i];
+  }
+
+  if (workers.size() < 2) {
+    RunSerial();
+  }
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::Search(ChessEngine& searcher, TestPosition& pos)
+{
+  if (!noClear) {
+    searcher.ClearSearchData();
+  }
+
+  pos.bestmove = searcher.Go(maxDepth, 0, maxTime);
+  searcher.GetStats(&pos.depth, &pos.seldepth, &pos.nodes, &pos.qnodes,
+                    &pos.time);
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::Report(const TestPosition& pos)
+{
+  tested++;
+  if (pos.bestmove.empty() ||
+      (pos.best.size() && !pos.best.count(pos.bestmove)) ||
+      (pos.avoid.size() && pos.avoid.count(pos.bestmove)))
+  {
+    Output() << "--- FAILED! line " << pos.line << " ("
+             << Percent(passed, tested) << "%) " << pos.tail;
+  }
+  else {
+    passed++;
+    Output() << "--- Passed. line " << pos.line << " ("
+             << Percent(passed, tested) << "%) " << pos.tail;
+  }
+
+  if (pos.depth > maxSearchDepth) {
+    maxSearchDepth = pos.depth;
+  }
+  if ((minSearchDepth < 0) || (pos.depth < minSearchDepth)) {
+    minSearchDepth = pos.depth;
+  }
+  if (pos.seldepth > maxSeldepth) {
+    maxSeldepth = pos.seldepth;
+  }
+  if ((minSeldepth < 0) || (pos.seldepth < minSeldepth)) {
+    minSeldepth = pos.seldepth;
+  }
+  totalDepth += pos.depth;
+  totalNodes += pos.nodes;
+  totalQnodes += pos.qnodes;
+  totalSeldepth += pos.seldepth;
+  totalTime += pos.time;
+}
+
+//----------------------------------------------------------------------------
+void TestCommandHandle::WorkerSearch(void* data)
+{
+  Worker* worker = static_cast<Worker*>(data);
+  TestCommandHandle* handle = worker->handle;
+  ChessEngine* searcher = worker->engine;
+
+  try {
+    while (!searcher->StopRequested()) {
+      handle->mutex.Lock();
+      const size_t idx = handle->nextPosition++;
+      handle->mutex.Unlock();
+      if (idx >= handle->positions.size()) {
+        break;
       }
-      totalDepth += depth;
-      totalNodes += nodes;
-      totalQnodes += qnodes;
-      totalSeldepth += seldepth;
-      totalTime += time;
 
-      if (engine->StopRequested() || (maxCount && (tested >= maxCount))) {
+      TestPosition& pos = handle->positions[idx];
+      if (!searcher->SetPosition(pos.fen.c_str())) {
         break;
       }
+      handle->Search(*searcher, pos);
+
+      // report every finished position that is next in file order
+      handle->mutex.Lock();
+      pos.done = true;
+      while ((handle->nextReport < handle->positions.size()) &&
+             handle->positions[handle->nextReport].done)
+      {
+        const TestPosition& next = handle->positions[handle->nextReport++];
+        Output() << "--- Test " << (handle->tested + 1) << " at line "
+                 << next.line << ' ' << next.text;
+        if (handle->printBoard &&
+            handle->engine->SetPosition(next.fen.c_str()))
+        {
+          handle->engine->PrintBoard();
+        }
+        Output(Output::NoPrefix) << "bestmove " << next.bestmove;
+        handle->Report(next);
+      }
+      handle->mutex.Unlock();
     }
+  }
+  catch (const std::exception& e) {
+    Output() << "ERROR: " << e.what();
+  }
+  catch (...) {
+    Output() << "Unknown error!";
+  }
 
-    Output() << "--- Completed " << tested << " test positions";
-    Output() << "--- Passed    " << passed << " passed ("
-             << Percent(passed, tested) << "%)";
-    Output() << "--- Time      " << totalTime << " ("
-             << Average(totalTime, static_cast<uint64_t>(tested)) << " avg)";
-    Output() << "--- Nodes     " << totalNodes << ", "
-             << Rate((totalNodes / 1000), totalTime) << " KNodes/sec";
-    Output() << "--- QNodes    " << totalQnodes << " ("
-             << Percent(totalQnodes, totalNodes) << "%)";
-    Output() << "--- Depth     " << minSearchDepth << " min, "
-             << static_cast<int>(Average(totalDepth, tested)) << " avg, "
-             << maxSearchDepth << " max";
-    Output() << "--- SelDepth  " << minSeldepth << " min, "
-             << static_cast<int>(Average(totalSeldepth, tested)) << " avg, "
-             << maxSeldepth << " max";
+  handle->mutex.Lock();
+  handle->workersDone++;
+  handle->mutex.Unlock();
+}
 
-    engine->ShowStatsTotals();
+//----------------------------------------------------------------------------
+const char* BenchCommandHandle::_POSITIONS[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq - 0 14",
+  "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+  "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+  "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1",
+  "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+  "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+  "6k1/5ppp/8/8/8/8/1r3PPP/4R1K1 b - - 0 1",
+  "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+  NULL
+};
+
+//----------------------------------------------------------------------------
+bool BenchCommandHandle::Parse(const char* params)
+{
+  depth       = _DEFAULT_DEPTH;
+  hashSize    = _DEFAULT_HASH;
+  threadCount = 1;
+
+  // parameters are positional: depth, hash size, thread count
+  int* values[] = { &depth, &hashSize, &threadCount };
+  size_t count = 0;
+  while (params && *NextWord(params)) {
+    if ((count >= (sizeof(values) / sizeof(values[0]))) || !isdigit(*params)) {
+      Output() << "Unexpected token: " << params;
+      return false;
+    }
+    int value = 0;
+    while (*params && isdigit(*params)) {
+      value = ((10 * value) + (*params++ - '0'));
+    }
+    if (*params && !isspace(*params)) {
+      Output() << "usage: " << Usage();
+      return false;
+    }
+    *values[count++] = value;
+  }
+  if ((depth < 1) || (threadCount < 1)) {
+    Output() << "usage: " << Usage();
+    return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void BenchCommandHandle::Execute()
+{
+  if (!engine) {
+    Output() << "Engine not set for 'bench' command";
+    return;
+  }
+
+  // bench changes these, put them back when done
+  const std::string fen = engine->GetFEN();
+  const std::string oldHash = GetOptionValue("Hash");
+  const std::string oldThreads = GetOptionValue("Threads");
+
+  try {
+    // setting the hash size also clears the transposition table
+    if (!engine->SetEngineOption("Hash", std::to_string(hashSize))) {
+      Output() << "Cannot set Hash option to " << hashSize;
+    }
+    if ((!oldThreads.empty() || (threadCount > 1)) &&
+        !engine->SetEngineOption("Threads", std::to_string(threadCount)))
+    {
+      Output() << "Cannot set Threads option to " << threadCount;
+    }
+
+    engine->ClearStopFlags();
+    engine->ResetStatsTotals();
+
+    const uint64_t start = Now();
+    uint64_t totalNodes = 0;
+    int positions = 0;
+
+    for (int i = 0; _POSITIONS[i] && !engine->StopRequested(); ++i) {
+      Output() << "--- Bench position " << (i + 1) << ' ' << _POSITIONS[i];
+      if (!engine->SetPosition(_POSITIONS[i])) {
+        break;
+      }
+
+      engine->ClearSearchData();
+      engine->Go(depth);
+
+      uint64_t nodes = 0;
+      engine->GetStats(NULL, NULL, &nodes);
+      totalNodes += nodes;
+      positions++;
+    }
+
+    const uint64_t time = (Now() - start);
+    const uint64_t nps = static_cast<uint64_t>(Rate(totalNodes, time));
+    Output() << "--- Completed " << positions << " bench positions, depth "
+             << depth << ", hash " << hashSize << " MB, threads "
+             << threadCount;
+    Output() << "--- Time      " << time << " msecs";
+    Output() << "--- Nodes     " << totalNodes;
+    Output() << "--- NPS       " << nps;
+    if (threadCount > 1) {
+      Output() << "--- Node count varies from run to run with threads > 1";
+    }
   }
   catch (const std::exception& e) {
     Output() << "ERROR: " << e.what();
@@ -666,10 +971,26 @@ void TestCommandHandle::Execute()
     Output() << "Unknown error!";
   }
 
-  if (fp) {
-    fclose(fp);
-    fp = NULL;
+  if (!oldHash.empty()) {
+    engine->SetEngineOption("Hash", oldHash);
+  }
+  if (!oldThreads.empty()) {
+    engine->SetEngineOption("Threads", oldThreads);
+  }
+  engine->SetPosition(fen.c_str());
+}
+
+//----------------------------------------------------------------------------
+std::string BenchCommandHandle::GetOptionValue(const std::string& name) const
+{
+  const std::list<EngineOption> opts = engine->GetOptions();
+  std::list<EngineOption>::const_iterator it;
+  for (it = opts.begin(); it != opts.end(); ++it) {
+    if (it->GetName() == name) {
+      return it->GetValue();
+    }
   }
+  return std::string();
 }
 
 } // namespace senjo
@@ -25,6 +25,7 @@
 
 #include "ChessEngine.h"
 #include "Output.h"
+#include <vector>
 
 namespace senjo
 {
@@ -188,7 +189,7 @@ public:
   TestCommandHandle(ChessEngine* engine) : BackgroundCommand(engine) { }
   std::string Usage() const {
     return "test [print] [skip <x>] [count <x>] [depth <x>] [time <msecs>] "
-        "[gain <x>] [file <x> (default=" + _TEST_FILE + ")]";
+        "[gain <x>] [threads <x>] [file <x> (default=" + _TEST_FILE + ")]";
   }
   std::string Description() const {
     return "Find the best move for a suite of test positions.";
@@ -199,6 +200,73 @@ protected:
   void Execute();
 
 private:
+  //--------------------------------------------------------------------------
+  //! \brief A test position and the result of searching it
+  //--------------------------------------------------------------------------
+  struct TestPosition
+  {
+    int                   line;     ///< Line number in the test file
+    std::string           text;     ///< The test file line as read
+    std::string           fen;      ///< The position part of the line
+    std::string           tail;     ///< Remainder of the line after parsing
+    std::set<std::string> avoid;    ///< Moves to avoid (am)
+    std::set<std::string> best;     ///< Best moves (bm)
+    std::string           bestmove; ///< The move the engine chose
+    int                   depth;    ///< Search depth reached
+    int                   seldepth; ///< Selective search depth reached
+    uint64_t              nodes;    ///< Nodes searched
+    uint64_t              qnodes;   ///< Quiescence nodes searched
+    uint64_t              time;     ///< Search time in milliseconds
+    bool                  done;     ///< Has the position been searched?
+  };
+
+  //--------------------------------------------------------------------------
+  //! \brief An engine instance searching test positions on its own thread
+  //--------------------------------------------------------------------------
+  struct Worker
+  {
+    TestCommandHandle* handle;
+    ChessEngine*       engine;
+    Thread             thread;
+  };
+
+  //--------------------------------------------------------------------------
+  //! \brief Read test positions from the given file into 'positions'
+  //! Stops at the first invalid position, honors 'skipCount' and 'maxCount'.
+  //--------------------------------------------------------------------------
+  void LoadPositions(FILE* fp);
+
+  //--------------------------------------------------------------------------
+  //! \brief Search the test positions one at a time with 'engine'
+  //--------------------------------------------------------------------------
+  void RunSerial();
+
+  //--------------------------------------------------------------------------
+  //! \brief Search the test positions with 'threadCount' worker engines
+  //! Each worker takes the next unsearched position from 'positions'.
+  //! Results are reported in file order as soon as all earlier positions
+  //! are done.  Runs serially if the engine can't create worker instances.
+  //--------------------------------------------------------------------------
+  void RunParallel();
+
+  //--------------------------------------------------------------------------
+  //! \brief Search a test position with the given engine
+  //! \param[in] searcher The engine to search with, its position must be set
+  //! \param[out] pos The test position, receives the search results
+  //--------------------------------------------------------------------------
+  void Search(ChessEngine& searcher, TestPosition& pos);
+
+  //--------------------------------------------------------------------------
+  //! \brief Output pass/fail for a searched position and add it to totals
+  //--------------------------------------------------------------------------
+  void Report(const TestPosition& pos);
+
+  //--------------------------------------------------------------------------
+  //! \brief Thread function of a parallel test worker
+  //! \param[in] data The Worker object
+  //--------------------------------------------------------------------------
+  static void WorkerSearch(void* data);
+
   static const std::string _TEST_FILE;
 
   bool        noClear;
@@ -207,8 +275,67 @@ private:
   int         maxDepth;
   int         minGain;
   int         skipCount;
+  int         threadCount;
   uint64_t    maxTime;
   std::string fileName;
+
+  // positions and results, guarded by 'mutex' while workers are running
+  Mutex                     mutex;
+  std::vector<TestPosition> positions;
+  size_t                    nextPosition;
+  size_t                    nextReport;
+  size_t                    workersDone;
+  int                       maxSearchDepth;
+  int                       maxSeldepth;
+  int                       minSearchDepth;
+  int                       minSeldepth;
+  int                       passed;
+  int                       tested;
+  int                       totalDepth;
+  int                       totalSeldepth;
+  uint64_t                  totalNodes;
+  uint64_t                  totalQnodes;
+  uint64_t                  totalTime;
+};
+
+//----------------------------------------------------------------------------
+//! \brief Wrapper for the "bench" command (not a UCI command)
+//! Searches a fixed set of built-in positions to a fixed depth with cleared
+//! search data.  With one thread the total node count is deterministic, so
+//! it serves as a signature of the engine's search behavior.
+//----------------------------------------------------------------------------
+class BenchCommandHandle : public BackgroundCommand
+{
+public:
+  BenchCommandHandle(ChessEngine* engine) : BackgroundCommand(engine) { }
+  std::string Usage() const {
+    return "bench [depth (default=" + std::to_string(_DEFAULT_DEPTH) +
+        ")] [hash (default=" + std::to_string(_DEFAULT_HASH) +
+        ")] [threads (default=1)]";
+  }
+  std::string Description() const {
+    return "Search built-in positions, report node count and speed.";
+  }
+
+protected:
+  bool Parse(const char* params);
+  void Execute();
+
+private:
+  //--------------------------------------------------------------------------
+  //! \brief Get the current value of an engine option
+  //! \param[in] name The option name
+  //! \return The option value, empty if the engine has no such option
+  //--------------------------------------------------------------------------
+  std::string GetOptionValue(const std::string& name) const;
+
+  static const int   _DEFAULT_DEPTH = 9;
+  static const int   _DEFAULT_HASH  = 16;
+  static const char* _POSITIONS[];
+
+  int depth;
+  int hashSize;
+  int threadCount;
 };
 
 } // namespace senjo
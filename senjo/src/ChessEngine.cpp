@@ -30,14 +30,27 @@ namespace senjo
 // static variables
 //----------------------------------------------------------------------------
 bool        ChessEngine::_debug = false;
-bool        ChessEngine::_searching = false;
-bool        ChessEngine::_quit = false;
-int         ChessEngine::_stop = 0;
-uint64_t    ChessEngine::_startTime = 0;
-uint64_t    ChessEngine::_stopTime = 0;
 const char* ChessEngine::_STARTPOS =
     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+//----------------------------------------------------------------------------
+ChessEngine::ChessEngine()
+  : _quiet(false),
+    _searching(false),
+    _quit(false),
+    _stop(0),
+    _startTime(0),
+    _stopTime(0)
+{
+}
+
+//----------------------------------------------------------------------------
+ChessEngine::~ChessEngine()
+{
+  _quit = true;
+  timerThread.Join();
+}
+
 //----------------------------------------------------------------------------
 uint64_t ChessEngine::Perft(const int depth)
 {
@@ -115,7 +128,7 @@ void ChessEngine::Timer(void* data)
     uint64_t nodes = 0;
     uint64_t qnodes = 0;
 
-    while (!_quit) {
+    while (!engine->_quit) {
       const uint64_t now = Now();
       const uint64_t end = engine->GetStopTime();
 
@@ -123,7 +136,7 @@ void ChessEngine::Timer(void* data)
         if (end && ((now + 100) >= end)) {
           engine->Stop(StopReason::Timeout);
         }
-        else if (!engine->TimeoutOccurred() &&
+        else if (!engine->TimeoutOccurred() && !engine->IsQuiet() &&
                  (now >= (Output::LastOutput() + outputInterval)))
         {
           engine->GetStats(&depth, &seldepth, &nodes, &qnodes, &msecs,
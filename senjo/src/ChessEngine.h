@@ -47,6 +47,16 @@ public:
   //--------------------------------------------------------------------------
   static const char* _STARTPOS;
 
+  //--------------------------------------------------------------------------
+  //! \brief Constructor
+  //--------------------------------------------------------------------------
+  ChessEngine();
+
+  //--------------------------------------------------------------------------
+  //! \brief Destructor, waits for the timer thread to exit
+  //--------------------------------------------------------------------------
+  virtual ~ChessEngine();
+
   //--------------------------------------------------------------------------
   //! \brief Get the engine name
   //! \return The engine name
@@ -245,6 +255,16 @@ public:
   //--------------------------------------------------------------------------
   virtual bool CopyIsOK() { return true; }
 
+  //--------------------------------------------------------------------------
+  //! \brief Create another instance of this engine
+  //! The new instance has the same option settings as this engine and is
+  //! initialized, but it has its own position and search state, so it can
+  //! search at the same time as this engine.  Used by the 'test' command
+  //! to run test positions in parallel.  Delete it when no longer needed.
+  //! \return NULL if this engine does not support multiple instances
+  //--------------------------------------------------------------------------
+  virtual ChessEngine* CreateWorker() { return NULL; }
+
   //--------------------------------------------------------------------------
   //! \brief Do performance test on the current position
   //! This will call the MyPerft() method, which you must implement.
@@ -285,6 +305,18 @@ public:
   //--------------------------------------------------------------------------
   bool IsDebugOn() const { return _debug; }
 
+  //--------------------------------------------------------------------------
+  //! \brief Turn off search progress output (info lines) for this engine
+  //! \param[in] flag true to suppress search progress output
+  //--------------------------------------------------------------------------
+  void SetQuiet(const bool flag) { _quiet = flag; }
+
+  //--------------------------------------------------------------------------
+  //! \brief Is search progress output suppressed?
+  //! \return true if this engine should not output search progress
+  //--------------------------------------------------------------------------
+  bool IsQuiet() const { return _quiet; }
+
   //--------------------------------------------------------------------------
   //! \brief Is the engine currently executing the Go() method?
   //! It is not recommended to set this to true while Perft() is executing.
@@ -385,11 +417,13 @@ protected:
   Thread timerThread;
 
   static bool     _debug;
-  static bool     _searching;
-  static bool     _quit;
-  static int      _stop;
-  static uint64_t _startTime;
-  static uint64_t _stopTime;
+
+  bool            _quiet;
+  bool            _searching;
+  bool            _quit;
+  int             _stop;
+  uint64_t        _startTime;
+  uint64_t        _stopTime;
 };
 
 } // namespace senjo
@@ -29,6 +29,7 @@ namespace senjo {
 //----------------------------------------------------------------------------
 namespace token
 {
+  static const std::string Bench("bench");
   static const std::string Debug("debug");
   static const std::string Exit("exit");
   static const std::string Fen("fen");
@@ -157,6 +158,10 @@ bool UCIAdapter::DoCommand(const char* command)
     StopCommand();
     TestCommand(command);
   }
+  else if (ParamMatch(token::Bench, command)) {
+    StopCommand();
+    BenchCommand(command);
+  }
   else if (ParamMatch(token::Opts, command)) {
     OptsCommand(command);
   }
@@ -199,6 +204,7 @@ void UCIAdapter::HelpCommand(const char* /*params*/)
   Output() << "  " << token::Uci;
   Output() << "  " << token::UciNewGame;
   Output() << "Additional commands:";
+  Output() << "  " << token::Bench;
   Output() << "  " << token::Exit;
   Output() << "  " << token::Fen;
   Output() << "  " << token::Help;
@@ -210,6 +216,30 @@ void UCIAdapter::HelpCommand(const char* /*params*/)
   Output() << "Or enter move(s) in coordinate notation, e.g. d2d4 g8f6";
 }
 
+//----------------------------------------------------------------------------
+//! \brief Do the "bench" command (not a UCI command)
+//! Measure search speed on a fixed set of positions, parameters are optional
+//----------------------------------------------------------------------------
+void UCIAdapter::BenchCommand(const char* params)
+{
+  BenchCommandHandle* handle = new BenchCommandHandle(engine);
+  if (!handle) {
+    Output() << "Out of memory";
+    return;
+  }
+
+  if (params && ParamMatch(token::Help, params)) {
+    Output() << "usage: " << handle->Usage();
+    Output() << handle->Description();
+  }
+  else if (handle->ParseAndExecute(params, thread)) {
+    return;
+  }
+
+  delete handle;
+  handle = NULL;
+}
+
 //----------------------------------------------------------------------------
 //! \brief Do the "fen" command (not a UCI command)
 //! Print the FEN string for the current board position
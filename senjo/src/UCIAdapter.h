@@ -66,6 +66,7 @@ public:
 
 private:
   // custom commands
+  void BenchCommand(const char* params);
   bool ExitCommand(const char* params);
   void FENCommand(const char* params);
   void HelpCommand(const char* params);
@@ -36,47 +36,51 @@ static const std::string _TRUE = "true";
 //----------------------------------------------------------------------------
 // static ClubFoot class variables
 //----------------------------------------------------------------------------
-bool                ClubFoot::_ext = false;
-bool                ClubFoot::_iid = false;
-bool                ClubFoot::_initialized = false;
-bool                ClubFoot::_lmr = false;
-bool                ClubFoot::_nmp = false;
-bool                ClubFoot::_nmr = false;
-bool                ClubFoot::_oneReply = false;
-char                ClubFoot::_board[128] = {0};
-char                ClubFoot::_hist[0x100000] = {0};
-int                 ClubFoot::_contempt = 0;
-int                 ClubFoot::_delta = 0;
-int                 ClubFoot::_depth = 0;
-int                 ClubFoot::_drawScore[2] = {0};
-int                 ClubFoot::_futility = 0;
-int                 ClubFoot::_movenum = 0;
-int                 ClubFoot::_rzr = 0;
-int                 ClubFoot::_seldepth = 0;
-int                 ClubFoot::_tempo = 0;
-int                 ClubFoot::_test = 0;
-std::string         ClubFoot::_currmove;
-int64_t             ClubFoot::_hashSize = 0;
-ClubFoot            ClubFoot::_node[MaxPlies];
-std::set<uint64_t>  ClubFoot::_seen;
-Stats               ClubFoot::_stats;
-Stats               ClubFoot::_totalStats;
-TranspositionTable  ClubFoot::_tt;
-
-EngineOption ClubFoot::_optHash("Hash", "1024", EngineOption::Spin, 0, 4096);
-EngineOption ClubFoot::_optClearHash("Clear Hash", "", EngineOption::Button);
-EngineOption ClubFoot::_optContempt("Contempt", "0", EngineOption::Spin, 0, 50);
-EngineOption ClubFoot::_optDelta("Delta Pruning Margin", "0", EngineOption::Spin, 0, 9999);
-EngineOption ClubFoot::_optEXT("Check Extensions", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optFutility("Futility Pruning Delta", "200", EngineOption::Spin, 0, 9999);
-EngineOption ClubFoot::_optIID("Internal Iterative Deepening", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optLMR("Late Move Reductions", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optNMP("Null Move Pruning", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optNMR("Null Move Reductions", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optOneReply("One Reply Extensions", _TRUE, EngineOption::Checkbox);
-EngineOption ClubFoot::_optRZR("Razoring Delta", "500", EngineOption::Spin, 0, 9999);
-EngineOption ClubFoot::_optTempo("Tempo Bonus", "0", EngineOption::Spin, 0, 50);
-EngineOption ClubFoot::_optTest("Experimental Feature", "0", EngineOption::Spin, 0, 9999);
+MaterialTable       ClubFoot::_material;
+TranspositionTable  ClubFoot::_sharedHash;
+
+//----------------------------------------------------------------------------
+// indexed by (from - to + 119), bits: 0x01 white pawn, 0x02 black pawn,
+// 0x04 knight, 0x08 bishop, 0x10 rook, 0x20 queen, 0x40 king
+//----------------------------------------------------------------------------
+const char ClubFoot::_ATTACK_MASK[240] = {
+  0x28,0x00,0x00,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x00,0x00,0x28,0x00,
+  0x00,0x28,0x00,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x00,0x28,0x00,0x00,
+  0x00,0x00,0x28,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x28,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x28,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x28,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x00,0x28,0x00,0x00,0x30,0x00,0x00,0x28,0x00,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x00,0x00,0x28,0x04,0x30,0x04,0x28,0x00,0x00,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x00,0x00,0x04,0x69,0x70,0x69,0x04,0x00,0x00,0x00,0x00,0x00,0x00,
+  0x30,0x30,0x30,0x30,0x30,0x30,0x70,0x00,0x70,0x30,0x30,0x30,0x30,0x30,0x30,0x00,
+  0x00,0x00,0x00,0x00,0x00,0x04,0x6A,0x70,0x6A,0x04,0x00,0x00,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x00,0x00,0x28,0x04,0x30,0x04,0x28,0x00,0x00,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x00,0x28,0x00,0x00,0x30,0x00,0x00,0x28,0x00,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x00,0x28,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x28,0x00,0x00,0x00,0x00,
+  0x00,0x00,0x28,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x28,0x00,0x00,0x00,
+  0x00,0x28,0x00,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x00,0x28,0x00,0x00,
+  0x28,0x00,0x00,0x00,0x00,0x00,0x00,0x30,0x00,0x00,0x00,0x00,0x00,0x00,0x28,0x00
+};
+
+//----------------------------------------------------------------------------
+// indexed by (from - to + 119), direction to step from 'from' toward 'to'
+//----------------------------------------------------------------------------
+const char ClubFoot::_ATTACK_STEP[240] = {
+   17,  0,  0,  0,  0,  0,  0, 16,  0,  0,  0,  0,  0,  0, 15,  0,
+    0, 17,  0,  0,  0,  0,  0, 16,  0,  0,  0,  0,  0, 15,  0,  0,
+    0,  0, 17,  0,  0,  0,  0, 16,  0,  0,  0,  0, 15,  0,  0,  0,
+    0,  0,  0, 17,  0,  0,  0, 16,  0,  0,  0, 15,  0,  0,  0,  0,
+    0,  0,  0,  0, 17,  0,  0, 16,  0,  0, 15,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0, 17,  0, 16,  0, 15,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0, 17, 16, 15,  0,  0,  0,  0,  0,  0,  0,
+    1,  1,  1,  1,  1,  1,  1,  0, -1, -1, -1, -1, -1, -1, -1,  0,
+    0,  0,  0,  0,  0,  0,-15,-16,-17,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,-15,  0,-16,  0,-17,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,-15,  0,  0,-16,  0,  0,-17,  0,  0,  0,  0,  0,
+    0,  0,  0,-15,  0,  0,  0,-16,  0,  0,  0,-17,  0,  0,  0,  0,
+    0,  0,-15,  0,  0,  0,  0,-16,  0,  0,  0,  0,-17,  0,  0,  0,
+    0,-15,  0,  0,  0,  0,  0,-16,  0,  0,  0,  0,  0,-17,  0,  0,
+  -15,  0,  0,  0,  0,  0,  0,-16,  0,  0,  0,  0,  0,  0,-17,  0
+};
 
 //----------------------------------------------------------------------------
 const int ClubFoot::_KING_SQR[128] = {
@@ -215,6 +219,54 @@ const int ClubFoot::_PIECE_SQR[12][128] = {
   }
 };
 
+//----------------------------------------------------------------------------
+ClubFoot::ClubFoot()
+  : td(NULL),
+    board(NULL),
+    child(NULL),
+    parent(NULL),
+    moves(NULL),
+    pv(NULL),
+    ply(0),
+    moveCount(0),
+    moveIndex(0),
+    pvCount(0),
+    standPat(0),
+    depthChange(0),
+    nmrAttempt(0),
+    nullMoveOk(0),
+    lazyEval(false),
+    mcount(0),
+    rcount(0),
+    state(0),
+    checkState(CheckState::Unknown),
+    pieceKey(0),
+    pawnKey(0),
+    materialKey(0),
+    positionKey(0)
+{
+  memset(king, 0, sizeof(king));
+  memset(material, 0, sizeof(material));
+  memset(pst, 0, sizeof(pst));
+  memset(kingEval, 0, sizeof(kingEval));
+  memset(passers, 0, sizeof(passers));
+  memset(pieceCount, 0, sizeof(pieceCount));
+  memset(openFile, 0, sizeof(openFile));
+}
+
+//----------------------------------------------------------------------------
+ClubFoot::~ClubFoot()
+{
+  // root nodes own the search thread data of their node stack
+  if (td && (td->root == this)) {
+    SetThreadCount(1);
+    if (td->ctx->owner == this) {
+      delete td->ctx;
+    }
+    delete td;
+  }
+}
+
 //----------------------------------------------------------------------------
 std::string ClubFoot::GetEngineName() const
 {
@@ -244,109 +296,228 @@ std::string ClubFoot::GetCountryName() const
 }
 
 //----------------------------------------------------------------------------
-std::list<EngineOption> ClubFoot::GetOptions() const
+ClubFoot::Context::Context(ClubFoot* ownerEngine)
+  : owner(ownerEngine),
+    ext(false),
+    iid(false),
+    initialized(false),
+    lmr(false),
+    nmp(false),
+    nmr(false),
+    oneReply(false),
+    sharedHash(false),
+    contempt(0),
+    delta(0),
+    futility(0),
+    lazyMargin(0),
+    rzr(0),
+    tempo(0),
+    test(0),
+    threads(1),
+    hashSize(0),
+    perftNext(0),
+    perftDepth(0),
+    optHash("Hash", "1024", EngineOption::Spin, 0, 4096),
+    optClearHash("Clear Hash", "", EngineOption::Button),
+    optHashFile("Hash File", "clubfoot.hash", EngineOption::String),
+    optSaveHash("Save Hash", "", EngineOption::Button),
+    optLoadHash("Load Hash", "", EngineOption::Button),
+    optSharedHash("Shared Hash", "false", EngineOption::Checkbox),
+    optEvalCache("Eval Cache", "16", EngineOption::Spin, 0, 1024),
+    optPerftHash("Perft Hash", "0", EngineOption::Spin, 0, 4096),
+    optThreads("Threads", "1", EngineOption::Spin, 1, 64),
+    optContempt("Contempt", "0", EngineOption::Spin, 0, 50),
+    optDelta("Delta Pruning Margin", "0", EngineOption::Spin, 0, 9999),
+    optEXT("Check Extensions", _TRUE, EngineOption::Checkbox),
+    optFutility("Futility Pruning Delta", "200", EngineOption::Spin, 0, 9999),
+    optIID("Internal Iterative Deepening", _TRUE, EngineOption::Checkbox),
+    optLazyMargin("Lazy Eval Margin", "300", EngineOption::Spin, 0, 9999),
+    optLMR("Late Move Reductions", _TRUE, EngineOption::Checkbox),
+    optNMP("Null Move Pruning", _TRUE, EngineOption::Checkbox),
+    optNMR("Null Move Reductions", _TRUE, EngineOption::Checkbox),
+    optOneReply("One Reply Extensions", _TRUE, EngineOption::Checkbox),
+    optRZR("Razoring Delta", "500", EngineOption::Spin, 0, 9999),
+    optTempo("Tempo Bonus", "0", EngineOption::Spin, 0, 50),
+    optTest("Experimental Feature", "0", EngineOption::Spin, 0, 9999)
+{
+  memset(perftCounts, 0, sizeof(perftCounts));
+}
+
+//----------------------------------------------------------------------------
+std::list<EngineOption> ClubFoot::Context::GetOptions() const
 {
   std::list<EngineOption> opts;
-  opts.push_back(_optHash);
-  opts.push_back(_optClearHash);
-  opts.push_back(_optContempt);
-  opts.push_back(_optDelta);
-  opts.push_back(_optEXT);
-  opts.push_back(_optFutility);
-  opts.push_back(_optIID);
-  opts.push_back(_optLMR);
-  opts.push_back(_optNMP);
-  opts.push_back(_optNMR);
-  opts.push_back(_optOneReply);
-  opts.push_back(_optRZR);
-  opts.push_back(_optTempo);
-  opts.push_back(_optTest);
+  opts.push_back(optHash);
+  opts.push_back(optClearHash);
+  opts.push_back(optHashFile);
+  opts.push_back(optSaveHash);
+  opts.push_back(optLoadHash);
+  opts.push_back(optSharedHash);
+  opts.push_back(optEvalCache);
+  opts.push_back(optPerftHash);
+  opts.push_back(optThreads);
+  opts.push_back(optContempt);
+  opts.push_back(optDelta);
+  opts.push_back(optEXT);
+  opts.push_back(optFutility);
+  opts.push_back(optIID);
+  opts.push_back(optLazyMargin);
+  opts.push_back(optLMR);
+  opts.push_back(optNMP);
+  opts.push_back(optNMR);
+  opts.push_back(optOneReply);
+  opts.push_back(optRZR);
+  opts.push_back(optTempo);
+  opts.push_back(optTest);
   return opts;
 }
 
+//----------------------------------------------------------------------------
+std::list<EngineOption> ClubFoot::GetOptions() const
+{
+  // options belong to the context, show defaults until there is one
+  return td ? td->ctx->GetOptions() : Context(NULL).GetOptions();
+}
+
 //----------------------------------------------------------------------------
 bool ClubFoot::SetEngineOption(const std::string& optionName,
                                const std::string& optionValue)
 {
-  if (!stricmp(optionName.c_str(), _optHash.GetName().c_str())) {
-    if (_optHash.SetValue(optionValue)) {
-      SetHashSize(_optHash.GetIntValue());
+  if (!td) {
+    InitThreadData(0);
+  }
+
+  // table sizes and thread count are applied by Initialize() if not yet done
+  Context& ctx = *td->ctx;
+  if (!stricmp(optionName.c_str(), ctx.optHash.GetName().c_str())) {
+    if (ctx.optHash.SetValue(optionValue)) {
+      ctx.hashSize = ctx.optHash.GetIntValue();
+      if (ctx.initialized) {
+        SetHashSize(ctx.hashSize);
+      }
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optClearHash.GetName().c_str())) {
+  if (!stricmp(optionName.c_str(), ctx.optClearHash.GetName().c_str())) {
     ClearHash();
     return true;
   }
-  if (!stricmp(optionName.c_str(), _optContempt.GetName().c_str())) {
-    if (_optContempt.SetValue(optionValue)) {
-      _contempt = static_cast<int>(_optContempt.GetIntValue());
+  if (!stricmp(optionName.c_str(), ctx.optHashFile.GetName().c_str())) {
+    return ctx.optHashFile.SetValue(optionValue);
+  }
+  if (!stricmp(optionName.c_str(), ctx.optSaveHash.GetName().c_str())) {
+    SaveHash();
+    return true;
+  }
+  if (!stricmp(optionName.c_str(), ctx.optLoadHash.GetName().c_str())) {
+    LoadHash();
+    return true;
+  }
+  if (!stricmp(optionName.c_str(), ctx.optSharedHash.GetName().c_str())) {
+    if (ctx.optSharedHash.SetValue(optionValue)) {
+      if (ctx.initialized) {
+        SetSharedHash(ctx.optSharedHash.GetValue() == _TRUE);
+      }
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optDelta.GetName().c_str())) {
-    if (_optDelta.SetValue(optionValue)) {
-      _delta = static_cast<int>(_optDelta.GetIntValue());
+  if (!stricmp(optionName.c_str(), ctx.optEvalCache.GetName().c_str())) {
+    if (ctx.optEvalCache.SetValue(optionValue)) {
+      SetEvalCacheSize(ctx.optEvalCache.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optEXT.GetName().c_str())) {
-    if (_optEXT.SetValue(optionValue)) {
-      _ext = (_optEXT.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optPerftHash.GetName().c_str())) {
+    if (ctx.optPerftHash.SetValue(optionValue)) {
+      SetPerftHashSize(ctx.optPerftHash.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optFutility.GetName().c_str())) {
-    if (_optFutility.SetValue(optionValue)) {
-      _futility = static_cast<int>(_optFutility.GetIntValue());
+  if (!stricmp(optionName.c_str(), ctx.optThreads.GetName().c_str())) {
+    if (ctx.optThreads.SetValue(optionValue)) {
+      ctx.threads = static_cast<int>(ctx.optThreads.GetIntValue());
+      if (ctx.initialized) {
+        SetThreadCount(ctx.threads);
+      }
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optIID.GetName().c_str())) {
-    if (_optIID.SetValue(optionValue)) {
-      _iid = (_optIID.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optContempt.GetName().c_str())) {
+    if (ctx.optContempt.SetValue(optionValue)) {
+      ctx.contempt = static_cast<int>(ctx.optContempt.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optLMR.GetName().c_str())) {
-    if (_optLMR.SetValue(optionValue)) {
-      _lmr = (_optLMR.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optDelta.GetName().c_str())) {
+    if (ctx.optDelta.SetValue(optionValue)) {
+      ctx.delta = static_cast<int>(ctx.optDelta.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName .c_str(), _optNMP.GetName().c_str())) {
-    if (_optNMP.SetValue(optionValue)) {
-      _nmp = (_optNMP.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optEXT.GetName().c_str())) {
+    if (ctx.optEXT.SetValue(optionValue)) {
+      ctx.ext = (ctx.optEXT.GetValue() == _TRUE);
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optNMR.GetName().c_str())) {
-    if (_optNMR.SetValue(optionValue)) {
-      _nmr = (_optNMR.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optFutility.GetName().c_str())) {
+    if (ctx.optFutility.SetValue(optionValue)) {
+      ctx.futility = static_cast<int>(ctx.optFutility.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName .c_str(), _optOneReply.GetName().c_str())) {
-    if (_optOneReply.SetValue(optionValue)) {
-      _oneReply = (_optOneReply.GetValue() == _TRUE);
+  if (!stricmp(optionName.c_str(), ctx.optIID.GetName().c_str())) {
+    if (ctx.optIID.SetValue(optionValue)) {
+      ctx.iid = (ctx.optIID.GetValue() == _TRUE);
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optRZR.GetName().c_str())) {
-    if (_optRZR.SetValue(optionValue)) {
-      _rzr = static_cast<int>(_optRZR.GetIntValue());
+  if (!stricmp(optionName.c_str(), ctx.optLazyMargin.GetName().c_str())) {
+    if (ctx.optLazyMargin.SetValue(optionValue)) {
+      ctx.lazyMargin = static_cast<int>(ctx.optLazyMargin.GetIntValue());
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optTempo.GetName().c_str())) {
-    if (_optTempo.SetValue(optionValue)) {
-      _tempo = static_cast<int>(_optTempo.GetIntValue());
+  if (!stricmp(optionName.c_str(), ctx.optLMR.GetName().c_str())) {
+    if (ctx.optLMR.SetValue(optionValue)) {
+      ctx.lmr = (ctx.optLMR.GetValue() == _TRUE);
       return true;
     }
   }
-  if (!stricmp(optionName.c_str(), _optTest.GetName().c_str())) {
-    if (_optTest.SetValue(optionValue)) {
-      _test = static_cast<int>(_optTest.GetIntValue());
+  if (!stricmp(optionName .c_str(), ctx.optNMP.GetName().c_str())) {
+    if (ctx.optNMP.SetValue(optionValue)) {
+      ctx.nmp = (ctx.optNMP.GetValue() == _TRUE);
+      return true;
+    }
+  }
+  if (!stricmp(optionName.c_str(), ctx.optNMR.GetName().c_str())) {
+    if (ctx.optNMR.SetValue(optionValue)) {
+      ctx.nmr = (ctx.optNMR.GetValue() == _TRUE);
+      return true;
+    }
+  }
+  if (!stricmp(optionName .c_str(), ctx.optOneReply.GetName().c_str())) {
+    if (ctx.optOneReply.SetValue(optionValue)) {
+      ctx.oneReply = (ctx.optOneReply.GetValue() == _TRUE);
+      return true;
+    }
+  }
+  if (!stricmp(optionName.c_str(), ctx.optRZR.GetName().c_str())) {
+    if (ctx.optRZR.SetValue(optionValue)) {
+      ctx.rzr = static_cast<int>(ctx.optRZR.GetIntValue());
+      return true;
+    }
+  }
+  if (!stricmp(optionName.c_str(), ctx.optTempo.GetName().c_str())) {
+    if (ctx.optTempo.SetValue(optionValue)) {
+      ctx.tempo = static_cast<int>(ctx.optTempo.GetIntValue());
+      ctx.evalCache.Clear(); // cached evals include tempo bonus
+      return true;
+    }
+  }
+  if (!stricmp(optionName.c_str(), ctx.optTest.GetName().c_str())) {
+    if (ctx.optTest.SetValue(optionValue)) {
+      ctx.test = static_cast<int>(ctx.optTest.GetIntValue());
       return true;
     }
   }
@@ -356,40 +527,65 @@ bool ClubFoot::SetEngineOption(const std::string& optionName,
 //----------------------------------------------------------------------------
 void ClubFoot::Initialize()
 {
-  ply = 0;
-  child = _node;
-  parent = NULL;
-  for (int i = 0; i < MaxPlies; ++i) {
-    _node[i].ply = (i + 1);
-    _node[i].child = ((i + 1) < MaxPlies) ? &(_node[i + 1]) : NULL;
-    _node[i].parent = (i > 0) ? &(_node[i - 1]) : this;
-  }
-
-  _hashSize = _optHash.GetIntValue();
-  _contempt = static_cast<int>(_optContempt.GetIntValue());
-  _delta    = static_cast<int>(_optDelta.GetIntValue());
-  _futility = static_cast<int>(_optFutility.GetIntValue());
-  _rzr      = static_cast<int>(_optRZR.GetIntValue());
-  _tempo    = static_cast<int>(_optTempo.GetIntValue());
-  _test     = static_cast<int>(_optTest.GetIntValue());
-  _ext      = (_optEXT.GetValue() == _TRUE);
-  _iid      = (_optIID.GetValue() == _TRUE);
-  _lmr      = (_optLMR.GetValue() == _TRUE);
-  _nmp      = (_optNMP.GetValue() == _TRUE);
-  _nmr      = (_optNMR.GetValue() == _TRUE);
-  _oneReply = (_optOneReply.GetValue() == _TRUE);
+  if (!td) {
+    InitThreadData(0);
+  }
+
+  Context& ctx = *td->ctx;
+  ctx.hashSize = ctx.optHash.GetIntValue();
+  ctx.contempt = static_cast<int>(ctx.optContempt.GetIntValue());
+  ctx.delta    = static_cast<int>(ctx.optDelta.GetIntValue());
+  ctx.futility = static_cast<int>(ctx.optFutility.GetIntValue());
+  ctx.lazyMargin = static_cast<int>(ctx.optLazyMargin.GetIntValue());
+  ctx.rzr      = static_cast<int>(ctx.optRZR.GetIntValue());
+  ctx.tempo    = static_cast<int>(ctx.optTempo.GetIntValue());
+  ctx.test     = static_cast<int>(ctx.optTest.GetIntValue());
+  ctx.threads  = static_cast<int>(ctx.optThreads.GetIntValue());
+  ctx.ext      = (ctx.optEXT.GetValue() == _TRUE);
+  ctx.iid      = (ctx.optIID.GetValue() == _TRUE);
+  ctx.lmr      = (ctx.optLMR.GetValue() == _TRUE);
+  ctx.nmp      = (ctx.optNMP.GetValue() == _TRUE);
+  ctx.nmr      = (ctx.optNMR.GetValue() == _TRUE);
+  ctx.oneReply = (ctx.optOneReply.GetValue() == _TRUE);
 
   ClearHistory();
-  SetHashSize(_hashSize);
+  SetThreadCount(ctx.threads);
+  SetSharedHash(ctx.optSharedHash.GetValue() == _TRUE);
+  if (!ctx.sharedHash || !_sharedHash.GetMegabytes()) {
+    SetHashSize(ctx.hashSize); // shared table keeps its first size
+  }
+  SetEvalCacheSize(ctx.optEvalCache.GetIntValue());
+  SetPerftHashSize(ctx.optPerftHash.GetIntValue());
   SetPosition(_STARTPOS);
 
-  _initialized = true;
+  ctx.initialized = true;
+}
+
+//----------------------------------------------------------------------------
+senjo::ChessEngine* ClubFoot::CreateWorker()
+{
+  if (!IsInitialized()) {
+    return NULL;
+  }
+
+  // workers search on a single thread with this engine's settings and
+  // their own transposition table, even if this engine's table is shared
+  ClubFoot* worker = new ClubFoot;
+  worker->InitThreadData(0, td->ctx);
+  worker->td->tt = &(worker->td->hashTable);
+  worker->ClearHistory();
+  worker->SetHashSize(td->ctx->hashSize);
+  if (!worker->SetPosition(_STARTPOS)) {
+    delete worker;
+    return NULL;
+  }
+  return worker;
 }
 
 //----------------------------------------------------------------------------
 bool ClubFoot::IsInitialized() const
 {
-  return _initialized;
+  return (td && td->ctx->initialized);
 }
 
 //----------------------------------------------------------------------------
@@ -408,8 +604,11 @@ const char* ClubFoot::SetPosition(const char* fen)
   int boardState = 0;
   Square epSquare;
   uint64_t pcKey = 0;
+  uint64_t pwnKey = 0;
+  char pieceTotal[14];
 
   memset(tmpBoard, 0, sizeof(tmpBoard));
+  memset(pieceTotal, 0, sizeof(pieceTotal));
 
   const char* p = fen;
   for (int y = 7; y >= 0; --y, ++p) {
@@ -438,6 +637,7 @@ const char* ClubFoot::SetPosition(const char* fen)
         tmpBoard[SQR(x,y)] = (White|Pawn);
         materialTotal[White] += PawnValue;
         pcKey ^= _HASH[White|Pawn][SQR(x,y)];
+        pwnKey ^= _HASH[White|Pawn][SQR(x,y)];
         break;
       case 'Q':
         tmpBoard[SQR(x,y)] = (White|Queen);
@@ -468,6 +668,7 @@ const char* ClubFoot::SetPosition(const char* fen)
         tmpBoard[SQR(x,y)] = (Black|Pawn);
         materialTotal[Black] += PawnValue;
         pcKey ^= _HASH[Black|Pawn][SQR(x,y)];
+        pwnKey ^= _HASH[Black|Pawn][SQR(x,y)];
         break;
       case 'q':
         tmpBoard[SQR(x,y)] = (Black|Queen);
@@ -565,8 +766,31 @@ const char* ClubFoot::SetPosition(const char* fen)
     }
   }
 
-  _seen.clear();
-  memcpy(_board, tmpBoard, sizeof(_board));
+  int colorTotal[2] = { 0, 0 };
+  for (Square sqr = Square::A1; sqr.IsValid(); ++sqr) {
+    if (tmpBoard[sqr.Name()]) {
+      pieceTotal[static_cast<int>(tmpBoard[sqr.Name()])]++;
+      colorTotal[COLOR_OF(tmpBoard[sqr.Name()])]++;
+    }
+  }
+  if ((colorTotal[White] > ThreadData::MaxPieces) ||
+      (colorTotal[Black] > ThreadData::MaxPieces))
+  {
+    Output() << "Too many pieces";
+    return NULL;
+  }
+
+  memset(td->keys, 0, sizeof(td->keys));
+  memcpy(board, tmpBoard, sizeof(tmpBoard));
+  td->listSize[White] = td->listSize[Black] = 0;
+  pst[White] = pst[Black] = 0;
+  for (Square sqr = Square::A1; sqr.IsValid(); ++sqr) {
+    if (board[sqr.Name()]) {
+      AddPiece(COLOR_OF(board[sqr.Name()]), sqr.Name());
+      pst[COLOR_OF(board[sqr.Name()])] += PstValue(board[sqr.Name()],
+                                                   sqr.Name());
+    }
+  }
   memcpy(king, kingPosition, sizeof(king));
   memcpy(material, materialTotal, sizeof(material));
 
@@ -576,6 +800,8 @@ const char* ClubFoot::SetPosition(const char* fen)
   ep          = epSquare;
   checkState  = CheckState::Unknown;
   pieceKey    = pcKey;
+  pawnKey     = pwnKey;
+  materialKey = MaterialTable::GetKey(pieceTotal);
   positionKey = (pcKey ^ _HASH[0][state & FiveBits] ^ _HASH[0][ep.Name()]);
 
   if (WhiteToMove()
@@ -603,8 +829,8 @@ const char* ClubFoot::MakeMove(const char* str)
 
   int from  = SQR(TO_X(str[0]), TO_Y(str[1]));
   int to    = SQR(TO_X(str[2]), TO_Y(str[3]));
-  int pc    = _board[from];
-  int cap   = _board[to];
+  int pc    = board[from];
+  int cap   = board[to];
   int promo = 0;
 
   const char* p = (str + 4);
@@ -650,6 +876,11 @@ const char* ClubFoot::MakeMove(const char* str)
     return NULL;
   }
 
+  // shift the current position into the game history
+  memmove(td->keys, (td->keys + 1),
+          ((ThreadData::GameKeys - 1) * sizeof(td->keys[0])));
+  td->keys[ThreadData::GameKeys - 1] = positionKey;
+
   if (WhiteToMove()) {
     Exec<White>(moves[moveIndex], *this);
   }
@@ -671,7 +902,7 @@ std::string ClubFoot::GetFEN() const
   // piece positions
   for (int y = 7; y >= 0; --y) {
     for (int x = 0; x < 8; ++x) {
-      if ((type = _board[SQR(x,y)]) && empty) {
+      if ((type = board[SQR(x,y)]) && empty) {
         *p++ = ('0' + empty);
         empty = 0;
       }
@@ -741,7 +972,7 @@ void ClubFoot::PrintBoard() const
 
   for (int y = 7; y >= 0; --y) {
     for (int x = 0; x < 8; ++x) {
-      switch (_board[SQR(x, y)]) {
+      switch (board[SQR(x, y)]) {
       case (White|Pawn):   out << " P"; break;
       case (White|Knight): out << " N"; break;
       case (White|Bishop): out << " B"; break;
@@ -808,9 +1039,16 @@ bool ClubFoot::WhiteToMove() const
 //----------------------------------------------------------------------------
 void ClubFoot::ClearSearchData()
 {
-  ClearHash();
+  // entries other engines stored in the shared table are left to age out
+  if (td->tt != &_sharedHash) {
+    td->tt->Invalidate();
+  }
   ClearHistory();
   ClearKillers();
+  for (size_t i = 0; i < td->helpers.size(); ++i) {
+    td->helpers[i]->ClearHistory();
+    td->helpers[i]->ClearKillers();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -824,19 +1062,24 @@ void ClubFoot::Quit() {
   // stop searching and exit the timer thread
   ChessEngine::Quit();
 
-  // free up memory allocated for the transposition table
-  SetHashSize(0);
+  // the search and perft threads may not have seen the stop yet, so the
+  // transposition table, eval cache, perft hash and helper threads are all
+  // released by the destructor, after those threads have been joined
 }
 
 //----------------------------------------------------------------------------
 void ClubFoot::ResetStatsTotals() {
-  _totalStats.Clear();
+  if (td) {
+    td->ctx->totalStats.Clear();
+  }
 }
 
 //----------------------------------------------------------------------------
 void ClubFoot::ShowStatsTotals() const {
   Output() << "--- Averaged Stats";
-  _totalStats.Average().Print();
+  if (td) {
+    td->ctx->totalStats.Average().Print();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -850,32 +1093,35 @@ void ClubFoot::GetStats(int* depth,
                         const size_t movelen) const
 {
   if (depth) {
-    *depth = _depth;
+    *depth = td->depth;
   }
   if (seldepth) {
-    *seldepth = _seldepth;
+    *seldepth = td->seldepth;
   }
   if (nodes) {
-    *nodes = (_stats.snodes + _stats.qnodes);
+    *nodes = NodeCount();
   }
   if (qnodes) {
-    *qnodes = _stats.qnodes;
+    *qnodes = td->stats.qnodes;
+    for (size_t i = 0; i < td->helpers.size(); ++i) {
+      *qnodes += td->helpers[i]->td->stats.qnodes;
+    }
   }
   if (msecs) {
     *msecs = (Now() - _startTime);
   }
   if (movenum) {
-    *movenum = _movenum;
+    *movenum = td->movenum;
   }
   if (move && movelen) {
-    snprintf(move, movelen, "%s", _currmove.c_str());
+    snprintf(move, movelen, "%s", td->currmove.c_str());
   }
 }
 
 //----------------------------------------------------------------------------
 uint64_t ClubFoot::MyPerft(const int depth)
 {
-  if (!_initialized) {
+  if (!IsInitialized()) {
     Output() << "Engine not initialized";
     return 0;
   }
@@ -901,31 +1147,199 @@ std::string ClubFoot::MyGo(const int depth,
                            const uint64_t /*btime*/, const uint64_t /*binc*/,
                            std::string* /*ponder*/)
 {
-  if (!_initialized) {
+  if (!IsInitialized()) {
     Output() << "Engine not initialized";
     return std::string();
   }
 
   InitSearch();
+  td->tt->NextGeneration();
 
   int d = std::min<int>(depth, MaxPlies);
   if (d <= 0) {
     d = MaxPlies;
   }
+
+  StartHelpers();
   std::string bestmove = (WhiteToMove() ? SearchRoot<White>(d)
                                         : SearchRoot<Black>(d));
+  StopHelpers();
 
-  _totalStats += _stats;
+  Stats stats = td->stats;
+  for (size_t i = 0; i < td->helpers.size(); ++i) {
+    stats += td->helpers[i]->td->stats;
+  }
+
+  td->ctx->statsMutex.Lock();
+  td->ctx->totalStats += stats;
+  td->ctx->statsMutex.Unlock();
   if (_debug) {
     Output() << "--- Stats";
-    Output() << _tt.GetStores() << " stores, " << _tt.GetHits() << " hits, "
-             << _tt.GetCheckmates() << " checkmates, "
-             << _tt.GetStalemates() << " stalemates";
 
-    _stats.Print();
+    stats.Print();
   }
 
   return bestmove;
 }
 
+//----------------------------------------------------------------------------
+void ClubFoot::InitThreadData(const int id, Context* context)
+{
+  assert(!td);
+  td     = new ThreadData(this, id);
+  td->ctx  = (context ? context : new Context(this));
+  td->stop = &_stop;
+  td->tt   = (td->ctx->sharedHash ? &_sharedHash : &(td->hashTable));
+  board  = td->board;
+  ply    = 0;
+  child  = td->node;
+  parent = NULL;
+  pv     = td->pv;
+  ClearMoves();
+
+  // row for ply N of the triangular PV table holds (MaxPlies + 1 - N) moves
+  Move* row = td->pv;
+  for (int i = 0; i < MaxPlies; ++i) {
+    ClubFoot& node = td->node[i];
+    row += (MaxPlies + 1 - i);
+    node.td     = td;
+    node.board  = td->board;
+    node.ply    = (i + 1);
+    node.child  = ((i + 1) < MaxPlies) ? &(td->node[i + 1]) : NULL;
+    node.parent = (i > 0) ? &(td->node[i - 1]) : this;
+    node.pv     = row;
+    node.ClearMoves();
+  }
+  assert((row + 1) == (td->pv + ThreadData::PvSlots));
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::SetThreadCount(const int count)
+{
+  if (!td) {
+    return; // Initialize() sets the thread count
+  }
+
+  const size_t helperCount = static_cast<size_t>(std::max<int>(count - 1, 0));
+  while (td->helpers.size() > helperCount) {
+    // the helper's thread may still be finishing a stopped search
+    td->helpers.back()->td->thread.Join();
+    delete td->helpers.back();
+    td->helpers.pop_back();
+  }
+  while (td->helpers.size() < helperCount) {
+    ClubFoot* helper = new ClubFoot;
+    helper->InitThreadData(static_cast<int>(td->helpers.size() + 1),
+                           td->ctx);
+    helper->td->stop = td->stop;
+    helper->td->tt = td->tt;
+    td->helpers.push_back(helper);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::SetSharedHash(const bool shared)
+{
+  Context& ctx = *td->ctx;
+  if (ctx.sharedHash == shared) {
+    return;
+  }
+
+  ctx.sharedHash = shared;
+  td->tt = (shared ? &_sharedHash : &(td->hashTable));
+  for (size_t i = 0; i < td->helpers.size(); ++i) {
+    td->helpers[i]->td->tt = td->tt;
+  }
+  if (!ctx.initialized) {
+    return; // Initialize() sizes the table
+  }
+
+  if (shared) {
+    td->hashTable.Resize(0, 1);
+  }
+  if (!shared || !_sharedHash.GetMegabytes()) {
+    SetHashSize(ctx.hashSize); // shared table keeps its first size
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::StartHelpers(void (*function)(void*))
+{
+  if (td->helpers.empty()) {
+    return;
+  }
+
+  const std::string fen = GetFEN();
+  for (size_t i = 0; i < td->helpers.size(); ++i) {
+    ClubFoot* helper = td->helpers[i];
+    if (!helper->SetPosition(fen.c_str())) {
+      continue;
+    }
+    memcpy(helper->td->keys, td->keys, sizeof(td->keys));
+    helper->InitSearch();
+    if (!helper->td->thread.Start(function, helper)) {
+      Output() << "Failed to start helper search thread!";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::StopHelpers()
+{
+  if (td->helpers.empty()) {
+    return;
+  }
+
+  // helpers search until stopped, the main thread is done so stop them
+  Stop(StopReason::Timeout);
+  JoinHelpers();
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::JoinHelpers()
+{
+  for (size_t i = 0; i < td->helpers.size(); ++i) {
+    td->helpers[i]->td->thread.Join();
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::HelperSearch(void* data)
+{
+  ClubFoot* helper = static_cast<ClubFoot*>(data);
+  assert(helper && helper->td && helper->td->id);
+  if (helper->WhiteToMove()) {
+    helper->SearchRoot<White>(MaxPlies);
+  }
+  else {
+    helper->SearchRoot<Black>(MaxPlies);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClubFoot::HelperPerft(void* data)
+{
+  ClubFoot* helper = static_cast<ClubFoot*>(data);
+  assert(helper && helper->td && helper->td->id);
+  if (helper->WhiteToMove()) {
+    helper->GenerateMoves<White, false>(helper->td->ctx->perftDepth);
+    helper->SortMovesLexically();
+    helper->PerftClaimedMoves<White>(helper->td->ctx->perftDepth);
+  }
+  else {
+    helper->GenerateMoves<Black, false>(helper->td->ctx->perftDepth);
+    helper->SortMovesLexically();
+    helper->PerftClaimedMoves<Black>(helper->td->ctx->perftDepth);
+  }
+}
+
+//----------------------------------------------------------------------------
+int ClubFoot::NextPerftMove()
+{
+  td->ctx->perftMutex.Lock();
+  const int idx = td->ctx->perftNext++;
+  td->ctx->perftMutex.Unlock();
+  return idx;
+}
+
 } // namespace clubfoot
@@ -23,12 +23,15 @@
 #ifndef CLUBFOOT_H
 #define CLUBFOOT_H
 
+#include <vector>
+
 #include "senjo/src/ChessEngine.h"
 #include "senjo/src/Square.h"
 #include "senjo/src/Output.h"
 #include "Types.h"
 #include "Move.h"
 #include "HashTable.h"
+#include "Material.h"
 #include "Stats.h"
 
 namespace clubfoot
@@ -40,6 +43,12 @@ namespace clubfoot
 class ClubFoot : public senjo::ChessEngine
 {
 public:
+  //--------------------------------------------------------------------------
+  // constructor/destructor (implemented in ClubFoot.cpp)
+  //--------------------------------------------------------------------------
+  ClubFoot();
+  ~ClubFoot();
+
   //--------------------------------------------------------------------------
   // senjo::ChessEngine methods (implemented in Clubfoot.cpp)
   //--------------------------------------------------------------------------
@@ -56,6 +65,7 @@ public:
   const char* MakeMove(const char* str);
   void PrintBoard() const;
   void Initialize();
+  senjo::ChessEngine* CreateWorker();
   void ClearSearchData();
   void PonderHit();
   void Quit();
@@ -83,55 +93,194 @@ protected:
                    std::string* ponder = NULL);
 
 private:
+  friend class MicroBench; // times hot paths in isolation, see MicroBench.cpp
+
   //--------------------------------------------------------------------------
   // global constants
   //--------------------------------------------------------------------------
   static const int _KING_SQR[128];      // king-square value table
   static const int _PIECE_SQR[12][128]; // piece-square value table
+  static const char _ATTACK_MASK[240];  // see AttackBit()
+  static const char _ATTACK_STEP[240];  // see StepToward()
 
   //--------------------------------------------------------------------------
   // global variables
   //--------------------------------------------------------------------------
-  static bool                _ext;            // check extensions
-  static bool                _iid;            // internal iterative deepening
-  static bool                _initialized;    // is the engine initialized?
-  static bool                _lmr;            // late move reductions
-  static bool                _nmp;            // null move pruning
-  static bool                _nmr;            // null move reductions
-  static bool                _oneReply;       // one reply extensions
-  static char                _board[128];     // piece positions
-  static char                _hist[0x100000]; // move performance history
-  static int                 _contempt;       // contempt for draw value
-  static int                 _delta;          // delta pruning margin
-  static int                 _depth;          // current root search depth
-  static int                 _drawScore[2];   // score for getting a draw
-  static int                 _futility;       // futility pruning delta
-  static int                 _movenum;        // current root search move number
-  static int                 _rzr;            // razoring delta
-  static int                 _seldepth;       // current selective search depth
-  static int                 _tempo;          // tempo bonus for side to move
-  static int                 _test;           // new feature test value
-  static std::string         _currmove;       // current root search move
-  static int64_t             _hashSize;       // transposition table byte size
-  static ClubFoot            _node[MaxPlies]; // the node stack
-  static std::set<uint64_t>  _seen;           // position keys already seen
-  static Stats               _stats;          // misc counters
-  static Stats               _totalStats;     // sum of misc counters
-  static TranspositionTable  _tt;             // info about visited positions
-  static senjo::EngineOption _optHash;        // hash size option
-  static senjo::EngineOption _optClearHash;   // clear hash option
-  static senjo::EngineOption _optContempt;    // contempt for draw option
-  static senjo::EngineOption _optDelta;       // delta pruning margin option
-  static senjo::EngineOption _optEXT;         // check extensions option
-  static senjo::EngineOption _optFutility;    // futility pruning option
-  static senjo::EngineOption _optIID;         // intrnl iterative deepening opt
-  static senjo::EngineOption _optLMR;         // late move reductions option
-  static senjo::EngineOption _optNMP;         // null move pruning option
-  static senjo::EngineOption _optNMR;         // null move reduction option
-  static senjo::EngineOption _optOneReply;    // one reply extensions option
-  static senjo::EngineOption _optRZR;         // razoring delta option
-  static senjo::EngineOption _optTempo;       // tempo bonus option
-  static senjo::EngineOption _optTest;        // new feature testing option
+  static MaterialTable       _material;       // info about piece counts
+  static TranspositionTable  _sharedHash;     // see "Shared Hash" option
+
+  //--------------------------------------------------------------------------
+  //! \brief Settings and tables of one root engine
+  //! Created by the first call to InitThreadData() on a root engine and
+  //! shared by its helper threads and by the workers from CreateWorker(),
+  //! so they all see the same option values, eval cache, perft hash and
+  //! totals.  Options must therefore only be changed on the root engine
+  //! while neither it nor any of its helpers or workers is searching.
+  //! Separately constructed root engines each get their own context, so
+  //! they can be configured independently and search at the same time.
+  //--------------------------------------------------------------------------
+  struct Context
+  {
+    explicit Context(ClubFoot* ownerEngine);
+
+    std::list<senjo::EngineOption> GetOptions() const;
+
+    ClubFoot*           owner;          // the engine that deletes this
+    bool                ext;            // check extensions
+    bool                iid;            // internal iterative deepening
+    bool                initialized;    // is the engine initialized?
+    bool                lmr;            // late move reductions
+    bool                nmp;            // null move pruning
+    bool                nmr;            // null move reductions
+    bool                oneReply;       // one reply extensions
+    bool                sharedHash;     // use the process wide hash table?
+    int                 contempt;       // contempt for draw value
+    int                 delta;          // delta pruning margin
+    int                 futility;       // futility pruning delta
+    int                 lazyMargin;     // lazy evaluation margin
+    int                 rzr;            // razoring delta
+    int                 tempo;          // tempo bonus for side to move
+    int                 test;           // new feature test value
+    int                 threads;        // number of search threads
+    int64_t             hashSize;       // transposition table byte size
+    Stats               totalStats;     // sum of misc counters
+    senjo::Mutex        statsMutex;     // guards totalStats
+    PerftTable          perftTable;     // leaf counts of perft subtrees
+    senjo::Mutex        perftMutex;     // guards perftNext
+    int                 perftNext;      // next root move to claim
+    int                 perftDepth;     // depth of parallel perft
+    uint64_t            perftCounts[MaxMoves]; // leaves per root move
+    EvalCache           evalCache;      // static evaluation results
+    senjo::EngineOption optHash;        // hash size option
+    senjo::EngineOption optClearHash;   // clear hash option
+    senjo::EngineOption optHashFile;    // hash save/load file option
+    senjo::EngineOption optSaveHash;    // save hash to file option
+    senjo::EngineOption optLoadHash;    // load hash from file option
+    senjo::EngineOption optSharedHash;  // shared hash table option
+    senjo::EngineOption optEvalCache;   // eval cache size option
+    senjo::EngineOption optPerftHash;   // perft hash size option
+    senjo::EngineOption optThreads;     // search thread count option
+    senjo::EngineOption optContempt;    // contempt for draw option
+    senjo::EngineOption optDelta;       // delta pruning margin option
+    senjo::EngineOption optEXT;         // check extensions option
+    senjo::EngineOption optFutility;    // futility pruning option
+    senjo::EngineOption optIID;         // intrnl iterative deepening opt
+    senjo::EngineOption optLazyMargin;  // lazy evaluation margin option
+    senjo::EngineOption optLMR;         // late move reductions option
+    senjo::EngineOption optNMP;         // null move pruning option
+    senjo::EngineOption optNMR;         // null move reduction option
+    senjo::EngineOption optOneReply;    // one reply extensions option
+    senjo::EngineOption optRZR;         // razoring delta option
+    senjo::EngineOption optTempo;       // tempo bonus option
+    senjo::EngineOption optTest;        // new feature testing option
+  };
+
+  //--------------------------------------------------------------------------
+  //! \brief Data owned by one search thread, shared by all nodes in its stack
+  //! The main search thread is id 0, helper threads are id 1 and up.
+  //--------------------------------------------------------------------------
+  struct ThreadData
+  {
+    enum {
+      GameKeys  = 100,    // game history slots in 'keys' (enough for rcount < 100)
+      PawnSlots = 0x4000, // number of entries in 'pawns' (must be power of 2)
+      MaxPieces = 16,     // max entries per color in 'pieceList'
+      MoveSlots = ((MaxPlies + 1) * MaxMoves), // entries in 'moves'
+      PvSlots   = (((MaxPlies + 1) * (MaxPlies + 2)) / 2) // entries in 'pv'
+    };
+
+    ThreadData(ClubFoot* rootNode, const int threadId)
+      : root(rootNode),
+        node(new ClubFoot[MaxPlies]),
+        ctx(NULL),
+        stop(NULL),
+        tt(&hashTable),
+        id(threadId),
+        depth(0),
+        movenum(0),
+        seldepth(0)
+    {
+      memset(board, 0, sizeof(board));
+      memset(pieceIndex, 0, sizeof(pieceIndex));
+      memset(pieceList, 0, sizeof(pieceList));
+      memset(listSize, 0, sizeof(listSize));
+      memset(hist, 0, sizeof(hist));
+      memset(keys, 0, sizeof(keys));
+      memset(pawns, 0, sizeof(pawns));
+      memset(drawScore, 0, sizeof(drawScore));
+    }
+
+    ~ThreadData() {
+      delete[] node;
+    }
+
+    ClubFoot*          root;           // the root node (owns this data)
+    ClubFoot*          node;           // the node stack
+    Context*           ctx;            // settings of the engine
+    const int*         stop;           // stop flags of the engine searching
+    TranspositionTable* tt;            // hash table used by this thread
+    TranspositionTable hashTable;      // 'tt' at id 0 unless hash is shared
+    std::vector<ClubFoot*> helpers;    // helper search thread roots (id 0)
+    int                id;             // search thread id
+    int                drawScore[2];   // score for getting a draw
+    int                depth;          // current root search depth
+    int                movenum;        // current root search move number
+    int                seldepth;       // current selective search depth
+    std::string        currmove;       // current root search move
+    char               board[128];     // piece positions
+    char               pieceIndex[128]; // index of each piece in 'pieceList'
+    char               pieceList[2][MaxPieces]; // piece squares per color
+    int                listSize[2];    // number of pieces per color
+    char               hist[0x100000]; // move performance history
+    uint64_t           keys[GameKeys + MaxPlies + 1]; // see IsDraw()
+    PawnHashEntry      pawns[PawnSlots]; // pawn hash table, see PawnStructure()
+    Move               moves[MoveSlots]; // move arena, see ClearMoves()
+    Move               pv[PvSlots];    // triangular PV table, one row per ply
+    Stats              stats;          // misc counters
+    senjo::Thread      thread;         // runs helper searches
+  };
+
+  //--------------------------------------------------------------------------
+  // search thread management (implemented in ClubFoot.cpp)
+  //--------------------------------------------------------------------------
+  void InitThreadData(const int id, Context* context = NULL);
+  void SetThreadCount(const int count);
+  void SetSharedHash(const bool shared);
+  void StartHelpers(void (*function)(void*) = HelperSearch);
+  void JoinHelpers();
+  void StopHelpers();
+  static void HelperSearch(void* data);
+  static void HelperPerft(void* data);
+  int NextPerftMove();
+
+  //--------------------------------------------------------------------------
+  // search thread variables (same for all nodes in a node stack)
+  // Hot fields come first so descending into a node touches as few cache
+  // lines as possible; the bulky per-ply arrays live in ThreadData.
+  //--------------------------------------------------------------------------
+  ThreadData*   td;          // the search thread this node belongs to
+  char*         board;       // piece positions (td->board)
+  ClubFoot*     child;       // the node 1 ply after this node
+  ClubFoot*     parent;      // the node 1 ply before this one
+  Move*         moves;       // this node's slice of td->moves, see ClearMoves
+  Move*         pv;          // this node's row of td->pv, see InitThreadData
+
+  //--------------------------------------------------------------------------
+  // move selection and search variables
+  //--------------------------------------------------------------------------
+  int       ply;             // which ply is this node at?
+  int       moveCount;       // number of moves in this node's 'moves' array
+  int       moveIndex;       // which move in 'moves' array this node is on
+  int       moveStage;       // see MoveStage
+  int       badCapIndex;     // next losing capture in 'moves' array
+  int       badCapCount;     // end of losing captures in 'moves' array
+  int       pvCount;         // move count in this node's principal variation
+  int       standPat;        // positional eval from perspective of side to move
+  int       depthChange;     // depth at this node changed this much
+  int       nmrAttempt;      // was a null move reduction used at this node?
+  int       nullMoveOk;      // ok to try null move at this node?
+  bool      lazyEval;        // Evaluate() deferred by Exec(), see LazyEval()
+  Move      killer[2];       // recent moves to cause beta cutoff at this node
 
   //--------------------------------------------------------------------------
   // position related variables (updated by Exec)
@@ -139,34 +288,47 @@ private:
   Move          lastMove;    // the move that resulted in the current position
   int           king[2];     // king position for each color
   int           material[2]; // total material for each color
+  int           pst[2];      // piece-square totals, see PstValue()
   int           mcount;      // half-move count
   int           rcount;      // reversible half-move count
   int           state;       // bit flags: side to move, castle rights, draw
   senjo::Square ep;          // en passant square
   CheckState    checkState;  // is the side to move in check?
   uint64_t      pieceKey;    // XOR-ed combination of piece/square hash values
+  uint64_t      pawnKey;     // pieceKey with only the pawn hash values
+  uint32_t      materialKey; // piece counts, see MaterialTable
   uint64_t      positionKey; // pieceKey ^ state ^ ep hash values
 
   //--------------------------------------------------------------------------
-  // other variables
+  // stages of move selection in Search(), see GetNextStagedMove()
   //--------------------------------------------------------------------------
-  int       ply;             // which ply is this node at?
-  int       standPat;        // positional eval from perspective of side to move
-  int       depthChange;     // depth at this node changed this much
-  int       nmrAttempt;      // was a null move reduction used at this node?
-  int       nullMoveOk;      // ok to try null move at this node?
-  int       moveCount;       // number of moves in this node's 'moves' array
-  int       moveIndex;       // which move in 'moves' array this node is on
-  int       pvCount;         // move count in this node's principal variation
+  enum MoveStage {
+    NotStarted,    // no moves generated yet
+    Evasions,      // in check, all evasions generated up front
+    GoodCaps,      // captures/promotions that don't lose material
+    Killer1,       // killer[0] if legal in this position
+    Killer2,       // killer[1] if legal in this position
+    GenQuiets,     // generate quiet moves
+    Quiets,        // quiet moves ordered by history
+    BadCaps,       // captures that appear to lose material
+    NoMoreMoves
+  };
+
+  //--------------------------------------------------------------------------
+  // check, pin and evaluation details
+  //--------------------------------------------------------------------------
+  int       checkCount;      // number of pieces giving check
+  int       pinCount;        // number of pieces pinned to our king
+  char      checker[2];      // squares of pieces giving check
+  char      pinned[8];       // squares of pinned pieces
+  char      pinStep[8];      // direction from our king to each pinned piece
+  int       discoCount;      // number of our pieces blocking our own checks
+  char      disco[8];        // squares of pieces that can discover check
+  char      discoStep[8];    // direction from enemy king to each of those
   int       kingEval[2];     // king positional evaluation score per color
-  char      passers[128];    // location of passers (2) and semi-passers (1)
-  char      pieceCount[14];  // piece counts per type
+  uint64_t  passers[2];      // semi-passers (0) and passers (1), see SquareBit
+  char      pieceCount[14];  // piece counts per type (see ProbeEvalCache)
   char      openFile[2][8];  // files with no pawns (per color)
-  ClubFoot* child;           // the node 1 ply after this node
-  ClubFoot* parent;          // the node 1 ply before this one
-  Move      killer[2];       // recent moves to cause beta cutoff at this node
-  Move      moves[MaxMoves]; // moves generated for the position at this node
-  Move      pv[MaxPlies];    // principal variation at this node
 
   //--------------------------------------------------------------------------
   //! Get the value of a given piece type
@@ -186,6 +348,33 @@ private:
     return VALUE[piece];
   }
 
+  //--------------------------------------------------------------------------
+  //! Get the bit that is set in _ATTACK_MASK[from - to + 119] when a piece
+  //! of the given type on 'from' square can attack 'to' square on an empty
+  //! board.  _ATTACK_MASK has one entry per 0x88 square difference.
+  //--------------------------------------------------------------------------
+  static inline int AttackBit(const int piece) {
+    assert((piece >= (White|Pawn)) && (piece <= (Black|King)));
+    return (piece < Knight) ? (1 << (piece & 1)) : (1 << (piece >> 1));
+  }
+
+  //--------------------------------------------------------------------------
+  //! Can a piece on \p from attack \p to square (ignoring blockers)?
+  //--------------------------------------------------------------------------
+  static inline bool CanAttack(const int piece, const int from, const int to) {
+    assert(!(from & ~0x77) && !(to & ~0x77));
+    return (_ATTACK_MASK[from - to + 119] & AttackBit(piece));
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the direction from \p from square to \p to square
+  //! \return 0 if the squares don't share a rank, file, or diagonal
+  //--------------------------------------------------------------------------
+  static inline int StepToward(const int from, const int to) {
+    assert(!(from & ~0x77) && !(to & ~0x77));
+    return _ATTACK_STEP[from - to + 119];
+  }
+
   //--------------------------------------------------------------------------
   //! Used to update castling rights effected by touching a given square
   //--------------------------------------------------------------------------
@@ -205,6 +394,48 @@ private:
     return TOUCH[square];
   }
 
+  //--------------------------------------------------------------------------
+  //! Get the bit that represents a given square in a 64 bit square mask
+  //--------------------------------------------------------------------------
+  static inline uint64_t SquareBit(const int square) {
+    assert(senjo::Square(square).IsValid());
+    return (1ULL << (((square & 0x70) >> 1) | (square & 7)));
+  }
+
+  //--------------------------------------------------------------------------
+  //! Append a piece to the piece list of the given color
+  //--------------------------------------------------------------------------
+  inline void AddPiece(const Color color, const int square) const {
+    assert(td->listSize[color] < ThreadData::MaxPieces);
+    td->pieceIndex[square] = static_cast<char>(td->listSize[color]);
+    td->pieceList[color][td->listSize[color]++] = static_cast<char>(square);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Remove a piece from the piece list of the given color
+  //! The last piece in the list takes the place of the removed piece.
+  //--------------------------------------------------------------------------
+  inline void RemovePiece(const Color color, const int square) const {
+    assert(td->listSize[color] > 0);
+    const int idx = td->pieceIndex[square];
+    const int last = td->pieceList[color][--td->listSize[color]];
+    assert(td->pieceList[color][idx] == square);
+    td->pieceList[color][idx] = static_cast<char>(last);
+    td->pieceIndex[last] = static_cast<char>(idx);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Update the piece list of the given color for a piece that moved
+  //--------------------------------------------------------------------------
+  inline void MovePiece(const Color color, const int from, const int to)
+    const
+  {
+    const int idx = td->pieceIndex[from];
+    assert(td->pieceList[color][idx] == from);
+    td->pieceList[color][idx] = static_cast<char>(to);
+    td->pieceIndex[to] = static_cast<char>(idx);
+  }
+
   //--------------------------------------------------------------------------
   //! Is it white's move or black's move in the position at this node?
   //--------------------------------------------------------------------------
@@ -217,38 +448,118 @@ private:
   //--------------------------------------------------------------------------
   inline int RazorDelta(const int depth) const {
     const int x = (64 * depth);
-    return (_rzr + (x * (x / 128)));
+    return (td->ctx->rzr + (x * (x / 128)));
   }
 
   //--------------------------------------------------------------------------
   //! Get centipawns above beta static eval must be for futility pruning
   //--------------------------------------------------------------------------
   inline int FutilityDelta(const int depth) const {
-    const int x = (_futility * depth);
+    const int x = (td->ctx->futility * depth);
     return std::max<int>(x, (x * (x / 256)));
   }
 
+  //--------------------------------------------------------------------------
+  //! Has the engine driving this node's search been told to stop?
+  //--------------------------------------------------------------------------
+  inline bool Stopping() const {
+    return (*td->stop != 0);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Is this engine using a shared table that another engine has already
+  //! sized?  The shared table keeps the size and content given by the first
+  //! engine to use it, other engines may be searching it at any time.
+  //! \param action What was refused, reported if the table is locked
+  //--------------------------------------------------------------------------
+  bool SharedHashLocked(const char* action) const {
+    if ((td->tt != &_sharedHash) || !_sharedHash.GetMegabytes()) {
+      return false;
+    }
+    senjo::Output() << "cannot " << action << " shared hash table of "
+                    << _sharedHash.GetMegabytes() << " MB";
+    return true;
+  }
+
   //--------------------------------------------------------------------------
   //! Set the size of the transposition table - this clears the table data
   //--------------------------------------------------------------------------
   void SetHashSize(const int64_t mbytes) {
-    if (!_tt.Resize(static_cast<size_t>(mbytes))) {
+    if (!td || SharedHashLocked("resize")) {
+      return;
+    }
+    const size_t size = static_cast<size_t>(mbytes);
+    if (!td->tt->Resize(size, td->ctx->threads)) {
       senjo::Output() << "cannot allocate hash table of " << mbytes << " MB";
     }
   }
 
+  //--------------------------------------------------------------------------
+  //! Set the size of the perft hash table - zero disables the table
+  //--------------------------------------------------------------------------
+  void SetPerftHashSize(const int64_t mbytes) {
+    if (!td->ctx->perftTable.Resize(static_cast<size_t>(mbytes))) {
+      senjo::Output() << "cannot allocate perft hash of " << mbytes << " MB";
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Set the size of the eval cache - zero disables the eval cache
+  //--------------------------------------------------------------------------
+  void SetEvalCacheSize(const int64_t mbytes) {
+    if (!td->ctx->evalCache.Resize(static_cast<size_t>(mbytes))) {
+      senjo::Output() << "cannot allocate eval cache of " << mbytes << " MB";
+    }
+  }
+
   //--------------------------------------------------------------------------
   //! Clear all data in the transposition table
   //--------------------------------------------------------------------------
   void ClearHash() {
-    _tt.Clear();
+    if (td && !SharedHashLocked("clear")) {
+      td->tt->Clear(td->ctx->threads);
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Write the transposition table to the file named by the Hash File option
+  //--------------------------------------------------------------------------
+  void SaveHash() {
+    const std::string path = td->ctx->optHashFile.GetValue();
+    if (td->tt->Save(path)) {
+      senjo::Output() << "saved " << td->tt->GetMegabytes()
+                      << " MB hash table to " << path;
+    }
+    else {
+      senjo::Output() << "cannot save hash table to " << path;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Replace the transposition table with the file named by the Hash File
+  //! option, the Hash option is updated to the size of the loaded table
+  //--------------------------------------------------------------------------
+  void LoadHash() {
+    if (SharedHashLocked("load into")) {
+      return;
+    }
+    const std::string path = td->ctx->optHashFile.GetValue();
+    if (td->tt->Load(path)) {
+      td->ctx->hashSize = static_cast<int64_t>(td->tt->GetMegabytes());
+      td->ctx->optHash.SetValue(std::to_string(td->ctx->hashSize));
+      senjo::Output() << "loaded " << td->ctx->hashSize
+                      << " MB hash table from " << path;
+    }
+    else {
+      senjo::Output() << "cannot load hash table from " << path;
+    }
   }
 
   //--------------------------------------------------------------------------
   //! Clear move performance history
   //--------------------------------------------------------------------------
   void ClearHistory() {
-    memset(_hist, 0, sizeof(_hist));
+    memset(td->hist, 0, sizeof(td->hist));
   }
 
   //--------------------------------------------------------------------------
@@ -258,8 +569,8 @@ private:
     killer[0].Clear();
     killer[1].Clear();
     for (int i = 0; i < MaxPlies; ++i) {
-      _node[i].killer[0].Clear();
-      _node[i].killer[1].Clear();
+      td->node[i].killer[0].Clear();
+      td->node[i].killer[1].Clear();
     }
   }
 
@@ -271,8 +582,8 @@ private:
     assert(depth >= 0);
     if (!check) {
       const int idx = move.GetHistoryIndex();
-      const int val = (_hist[idx] + depth + 2);
-      _hist[idx] = static_cast<char>(std::min<int>(val, 40));
+      const int val = (td->hist[idx] + depth + 2);
+      td->hist[idx] = static_cast<char>(std::min<int>(val, 40));
     }
   }
 
@@ -282,8 +593,8 @@ private:
   inline void DecHistory(const Move& move, const bool check) {
     if (!check) {
       const int idx = move.GetHistoryIndex();
-      const int val = (_hist[idx] - 1);
-      _hist[idx] = static_cast<char>(std::max<int>(val, -2));
+      const int val = (td->hist[idx] - 1);
+      td->hist[idx] = static_cast<char>(std::max<int>(val, -2));
     }
   }
 
@@ -312,7 +623,7 @@ private:
     pv[0] = move;
     if (child) {
       if ((pvCount = (child->pvCount + 1)) > 1) {
-        assert(pvCount <= MaxPlies);
+        assert(pvCount <= (MaxPlies + 1 - ply));
         memcpy((pv + 1), child->pv, (child->pvCount * sizeof(Move)));
       }
     }
@@ -327,20 +638,20 @@ private:
   //! \param bound 0 means score is exact, -1 = upperbound, +1 = lowerbound
   //--------------------------------------------------------------------------
   void OutputPV(const int score, const int bound = 0) const {
-    if (pvCount > 0) {
+    if ((pvCount > 0) && !td->id && !IsQuiet()) { // helpers don't report
       const uint64_t msecs = (senjo::Now() - _startTime);
       senjo::Output out(senjo::Output::NoPrefix);
 
-      const uint64_t nodes = (_stats.snodes + _stats.qnodes);
-      out << "info depth " << _depth
-          << " seldepth " << _seldepth
+      const uint64_t nodes = NodeCount();
+      out << "info depth " << td->depth
+          << " seldepth " << td->seldepth
           << " nodes " << nodes
           << " time " << msecs
           << " nps " << static_cast<uint64_t>(senjo::Rate(nodes, msecs));
 
       if (bound) {
-        out << " currmovenumber " << _movenum
-            << " currmove " << _currmove;
+        out << " currmovenumber " << td->movenum
+            << " currmove " << td->currmove;
       }
 
       if (abs(score) < MateScore) {
@@ -365,6 +676,18 @@ private:
     }
   }
 
+  //--------------------------------------------------------------------------
+  //! Get the number of nodes visited by all search threads
+  //--------------------------------------------------------------------------
+  uint64_t NodeCount() const {
+    uint64_t count = (td->stats.snodes + td->stats.qnodes);
+    for (size_t i = 0; i < td->helpers.size(); ++i) {
+      const Stats& stats = td->helpers[i]->td->stats;
+      count += (stats.snodes + stats.qnodes);
+    }
+    return count;
+  }
+
   //--------------------------------------------------------------------------
   //! Sort the 'moves' array according the string representation of the moves
   //--------------------------------------------------------------------------
@@ -384,29 +707,40 @@ private:
   }
 
   //--------------------------------------------------------------------------
-  //! Get the next move from this node's 'moves' array.
+  //! Move the highest scoring move in moves[index..end) to moves[index]
+  //! \param index The first candidate, incremented past the selected move
+  //! \param end One past the last candidate
+  //! \return The selected move
   //--------------------------------------------------------------------------
-  inline Move* GetNextMove() {
-    assert(moveIndex >= 0);
-    assert((moveCount >= 0) && (moveCount < MaxMoves));
+  inline Move* SelectMove(int& index, const int end) {
+    assert((index >= 0) && (index < end) && (end <= moveCount));
 
-    if (moveIndex >= moveCount) {
-      return NULL;
-    }
-
-    int best_index = moveIndex;
-    int best_score = moves[moveIndex].GetScore();
-    for (int i = (moveIndex + 1); i < moveCount; ++i) {
+    int best_index = index;
+    int best_score = moves[index].GetScore();
+    for (int i = (index + 1); i < end; ++i) {
       if (moves[i].GetScore() > best_score) {
         best_score = moves[i].GetScore();
         best_index = i;
       }
     }
-    if (best_index > moveIndex) {
-      moves[moveIndex].SwapWith(moves[best_index]);
+    if (best_index > index) {
+      moves[index].SwapWith(moves[best_index]);
     }
 
-    return (moves + moveIndex++);
+    return (moves + index++);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the next move from this node's 'moves' array.
+  //--------------------------------------------------------------------------
+  inline Move* GetNextMove() {
+    assert(moveIndex >= 0);
+    assert((moveCount >= 0) && (moveCount < MaxMoves));
+
+    if (moveIndex >= moveCount) {
+      return NULL;
+    }
+    return SelectMove(moveIndex, moveCount);
   }
 
   //--------------------------------------------------------------------------
@@ -414,86 +748,62 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline bool AttackedBy(const senjo::Square& sqr) const {
-    static const senjo::Direction DIRECTIONS[8] = {
-      senjo::SouthWest, senjo::South,
-      senjo::SouthEast, senjo::West,
-      senjo::East,      senjo::NorthWest,
-      senjo::North,     senjo::NorthEast
-    };
-
     if (!sqr.IsValid()) {
       return false;
     }
 
-    if ((_board[(sqr + senjo::KnightMove1).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove2).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove3).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove4).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove5).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove6).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove7).Name()] == (color|Knight)) ||
-        (_board[(sqr + senjo::KnightMove8).Name()] == (color|Knight)))
+    // pawn attackers
+    if (color == White) {
+      if ((board[(sqr + senjo::SouthWest).Name()] == (color|Pawn)) ||
+          (board[(sqr + senjo::SouthEast).Name()] == (color|Pawn)))
+      {
+        return true;
+      }
+    }
+    else {
+      if ((board[(sqr + senjo::NorthWest).Name()] == (color|Pawn)) ||
+          (board[(sqr + senjo::NorthEast).Name()] == (color|Pawn)))
+      {
+        return true;
+      }
+    }
+
+    // knight attackers
+    if ((board[(sqr + senjo::KnightMove1).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove2).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove3).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove4).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove5).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove6).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove7).Name()] == (color|Knight)) ||
+        (board[(sqr + senjo::KnightMove8).Name()] == (color|Knight)))
     {
       return true;
     }
 
-    int piece = 0;
-    senjo::Direction direction;
-    senjo::Square    dest;
-
-    for (int i = 0; i < 8; ++i) {
-      direction = DIRECTIONS[i];
-      for (dest = (sqr + direction); dest.IsValid(); dest += direction) {
-        switch ((piece = _board[dest.Name()])) {
-        case (color|Pawn):
-          if (sqr.DistanceTo(dest) == 1) {
-            if (color == White) {
-              switch (direction) {
-              case senjo::SouthWest: case senjo::SouthEast:
-                return true;
-              default:
-                break;
-              }
-            }
-            else {
-              switch (direction) {
-              case senjo::NorthWest: case senjo::NorthEast:
-                return true;
-              default:
-                break;
-              }
-            }
-          }
-          break;
-        case (color|Bishop):
-          switch (direction) {
-          case senjo::SouthWest: case senjo::SouthEast:
-          case senjo::NorthWest: case senjo::NorthEast:
-            return true;
-          default:
-            break;
-          }
-          break;
-        case (color|Rook):
-          switch (direction) {
-          case senjo::South: case senjo::West:
-          case senjo::East:  case senjo::North:
-            return true;
-          default:
-            break;
-          }
-          break;
-        case (color|Queen):
-          return true;
-        case (color|King):
-          if (sqr.DistanceTo(dest) == 1) {
-            return true;
-          }
-          break;
-        }
-        if (piece) {
-          break;
-        }
+    // slider and king attackers, only walk rays that can reach 'sqr'
+    // pieces temporarily moved by StaticExchange() or ExpandMove() leave
+    // an empty or mismatched square in the piece list, those are skipped
+    const char* pieces = td->pieceList[color];
+    const int to = sqr.Name();
+    int from;
+    int pc;
+    int step;
+    for (int i = 0; i < td->listSize[color]; ++i) {
+      from = pieces[i];
+      pc = board[from];
+      if ((pc < Bishop) || (COLOR_OF(pc) != color) ||
+          !CanAttack(pc, from, to))
+      {
+        continue;
+      }
+      if (pc == (color|King)) {
+        return true;
+      }
+      step = StepToward(from, to);
+      for (from += step; (from != to) && !board[from]; from += step) { }
+      if (from == to) {
+        return true;
       }
     }
     return false;
@@ -501,10 +811,24 @@ private:
 
   //--------------------------------------------------------------------------
   //! Is the position at this node a draw?
+  //! The 'keys' array of the search thread holds the last GameKeys position
+  //! keys of the game followed by the position keys on the current search
+  //! path (indexed by ply).  Only positions since the last irreversible move
+  //! can repeat, and only those with the same side to move, so only every
+  //! other key of the last 'rcount' keys need to be checked.
   //! \return True if the position at this node is a draw
   //--------------------------------------------------------------------------
   inline bool IsDraw() const {
-    return ((state & Draw) || (rcount >= 100) || _seen.count(positionKey));
+    if ((state & Draw) || (rcount >= 100)) {
+      return true;
+    }
+    const uint64_t* key = (td->keys + ThreadData::GameKeys + ply);
+    for (int i = 2; i <= rcount; i += 2) {
+      if (key[-i] == positionKey) {
+        return true;
+      }
+    }
+    return false;
   }
 
   //--------------------------------------------------------------------------
@@ -531,90 +855,80 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline int SmallestAttacker(const senjo::Square& to) const {
-    static const senjo::Direction DIRECTIONS[8] = {
-      senjo::SouthWest, senjo::SouthEast,
-      senjo::NorthWest, senjo::NorthEast,
-      senjo::South,     senjo::West,
-      senjo::East,      senjo::North
-    };
-
     if (!to.IsValid()) {
       return senjo::Square::None;
     }
 
-    senjo::Direction direction;
-    senjo::Square    sqr;
-    int              tmp;
+    int tmp;
 
     // pawn attackers
     if (color == White) {
-      if ((_board[tmp = (to + senjo::SouthWest).Name()] == (color|Pawn)) ||
-          (_board[tmp = (to + senjo::SouthEast).Name()] == (color|Pawn)))
+      if ((board[tmp = (to + senjo::SouthWest).Name()] == (color|Pawn)) ||
+          (board[tmp = (to + senjo::SouthEast).Name()] == (color|Pawn)))
       {
         return tmp;
       }
     }
     else {
-      if ((_board[tmp = (to + senjo::NorthWest).Name()] == (color|Pawn)) ||
-          (_board[tmp = (to + senjo::NorthEast).Name()] == (color|Pawn)))
+      if ((board[tmp = (to + senjo::NorthWest).Name()] == (color|Pawn)) ||
+          (board[tmp = (to + senjo::NorthEast).Name()] == (color|Pawn)))
       {
         return tmp;
       }
     }
 
     // knight attackers
-    if ((_board[tmp = (to + senjo::KnightMove1).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove2).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove3).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove4).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove5).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove6).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove7).Name()] == (color|Knight)) ||
-        (_board[tmp = (to + senjo::KnightMove8).Name()] == (color|Knight)))
+    if ((board[tmp = (to + senjo::KnightMove1).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove2).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove3).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove4).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove5).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove6).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove7).Name()] == (color|Knight)) ||
+        (board[tmp = (to + senjo::KnightMove8).Name()] == (color|Knight)))
     {
       return tmp;
     }
 
-    int queen = senjo::Square::None;
-    int king  = senjo::Square::None;
-
-    // bishop attackers
-    for (int i = 0; i < 4; ++i) {
-      direction = DIRECTIONS[i];
-      for (sqr = (to + direction); sqr.IsValid(); sqr += direction) {
-        switch ((tmp = _board[sqr.Name()])) {
-        case (color|Bishop): return sqr.Name();
-        case (color|Queen):
-          queen = sqr.Name();
-          break;
-        case (color|King):
-          if (sqr.DistanceTo(to) == 1) king = sqr.Name();
-          break;
-        }
-        if (tmp) break;
+    // slider and king attackers
+    const char* pieces = td->pieceList[color];
+    int attacker = senjo::Square::None;
+    int king = senjo::Square::None;
+    int value = Infinity;
+    int from;
+    int pc;
+    int step;
+    for (int i = 0; i < td->listSize[color]; ++i) {
+      from = pieces[i];
+      pc = board[from];
+      // pawns and knights are checked above, empty squares are pieces
+      // temporarily moved by StaticExchange()
+      if ((pc < Bishop) || (COLOR_OF(pc) != color) ||
+          !CanAttack(pc, from, to.Name()))
+      {
+        continue;
       }
-    }
-
-    // rook attackers
-    for (int i = 4; i < 8; ++i) {
-      direction = DIRECTIONS[i];
-      for (sqr = (to + direction); sqr.IsValid(); sqr += direction) {
-        switch ((tmp = _board[sqr.Name()])) {
-        case (color|Rook): return sqr.Name();
-        case (color|Queen):
-          queen = sqr.Name();
-          break;
-        case (color|King):
-          if (sqr.DistanceTo(to) == 1) king = sqr.Name();
-          break;
+      if (pc == (color|King)) {
+        king = from;
+        continue;
+      }
+      if (ValueOf(pc) >= value) {
+        continue;
+      }
+      step = StepToward(from, to.Name());
+      for (tmp = (from + step); (tmp != to.Name()) && !board[tmp];
+           tmp += step) { }
+      if (tmp == to.Name()) {
+        if (pc == (color|Bishop)) {
+          return from;
         }
-        if (tmp) break;
+        attacker = from;
+        value = ValueOf(pc);
       }
     }
 
-    // queen attackers
-    if (queen != senjo::Square::None) {
-      return queen;
+    if (attacker != senjo::Square::None) {
+      return attacker;
     }
 
     // king attacker
@@ -633,23 +947,23 @@ private:
   template<Color color>
   int StaticExchange(const senjo::Square& to) const {
     assert(to.IsValid());
-    assert(_board[to.Name()]);
-    assert(_board[to.Name()] < King);
-    assert(COLOR_OF(_board[to.Name()]) != color);
+    assert(board[to.Name()]);
+    assert(board[to.Name()] < King);
+    assert(COLOR_OF(board[to.Name()]) != color);
 
     int value = 0;
     senjo::Square from = SmallestAttacker<color>(to);
     if (from.IsValid()) {
-      const int piece = _board[from.Name()];
-      const int cap = _board[to.Name()];
+      const int piece = board[from.Name()];
+      const int cap = board[to.Name()];
       value = ValueOf(cap);
       if (piece < King) {
         if (ValueOf(piece) >= value) {
-          _board[to.Name()] = piece;
-          _board[from.Name()] = 0;
+          board[to.Name()] = piece;
+          board[from.Name()] = 0;
           value = std::max<int>(0, (value - StaticExchange<!color>(to)));
-          _board[from.Name()] = piece;
-          _board[to.Name()] = cap;
+          board[from.Name()] = piece;
+          board[to.Name()] = cap;
         }
       }
     }
@@ -667,15 +981,16 @@ private:
                       const int promo = PieceType::NoPiece)
   {
     assert((moveCount + 1) < MaxMoves);
+    assert((moves + moveCount + 1) < (td->moves + ThreadData::MoveSlots));
     assert(from.IsValid());
     assert(to.IsValid());
-    assert(COLOR_OF(_board[from.Name()]) == color);
+    assert(COLOR_OF(board[from.Name()]) == color);
     assert((!cap || ((cap >= Pawn) && (cap <= King))));
     assert(!promo || ((promo >= (White|Knight)) && (promo <= (Black|Queen))));
 
     const int fromSqr = from.Name();
     const int toSqr = to.Name();
-    const int pc = _board[fromSqr];
+    const int pc = board[fromSqr];
     int score = (SquareValue(pc, toSqr) - SquareValue(pc, fromSqr));
 
     if (promo) {
@@ -697,11 +1012,11 @@ private:
           score += (ValueOf(cap) - (10 * (pc & ~1)));
         }
         else {
-          _board[toSqr] = pc;
-          _board[fromSqr] = 0;
+          board[toSqr] = pc;
+          board[fromSqr] = 0;
           score += (ValueOf(cap) - StaticExchange<!color>(to));
-          _board[fromSqr] = pc;
-          _board[toSqr] = cap;
+          board[fromSqr] = pc;
+          board[toSqr] = cap;
         }
         break;
       case Move::PawnPush:
@@ -711,11 +1026,11 @@ private:
           score += ValueOf(cap);
         }
         else {
-          _board[toSqr] = pc;
-          _board[fromSqr] = 0;
+          board[toSqr] = pc;
+          board[fromSqr] = 0;
           score -= StaticExchange<!color>(to);
-          _board[fromSqr] = pc;
-          _board[toSqr] = cap;
+          board[fromSqr] = pc;
+          board[toSqr] = cap;
         }
         break;
       case Move::KingMove:
@@ -730,12 +1045,15 @@ private:
 
     Move& move = moves[moveCount++];
     move.Init(mtype, fromSqr, toSqr, pc, cap, promo, score);
+    if (GivesCheck<color, true>(fromSqr, toSqr, mtype, pc, promo)) {
+      move.SetGivesCheck();
+    }
     if (!move.IsCapOrPromo()) {
       if (IsKiller(move)) {
         move.Score() += 50;
       }
       else {
-        move.Score() += _hist[move.GetHistoryIndex()];
+        move.Score() += td->hist[move.GetHistoryIndex()];
       }
     }
   }
@@ -750,15 +1068,15 @@ private:
   {
     int piece = 0;
     senjo::Square sqr;
-    switch (from.DirectionTo(senjo::Square(king[color]))) {
+    switch (StepToward(from.Name(), king[color])) {
     case senjo::SouthWest:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::SouthWest: case senjo::NorthEast: return false;
       default:
         for (sqr = (from + senjo::SouthWest); sqr.IsValid();
              sqr += senjo::SouthWest)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -766,7 +1084,7 @@ private:
         for (sqr = (from + senjo::NorthEast); sqr.IsValid();
              sqr += senjo::NorthEast)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Bishop)) || (piece == ((!color)|Queen))) {
           return true;
@@ -774,13 +1092,13 @@ private:
       }
       break;
     case senjo::South:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::South: case senjo::North: return false;
       default:
         for (sqr = (from + senjo::South); sqr.IsValid();
              sqr += senjo::South)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -788,7 +1106,7 @@ private:
         for (sqr = (from + senjo::North); sqr.IsValid();
              sqr += senjo::North)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Rook)) || (piece == ((!color)|Queen))) {
           return true;
@@ -796,13 +1114,13 @@ private:
       }
       break;
     case senjo::SouthEast:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::SouthEast: case senjo::NorthWest: return false;
       default:
         for (sqr = (from + senjo::SouthEast); sqr.IsValid();
              sqr += senjo::SouthEast)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -810,7 +1128,7 @@ private:
         for (sqr = (from + senjo::NorthWest); sqr.IsValid();
              sqr += senjo::NorthWest)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Bishop)) || (piece == ((!color)|Queen))) {
           return true;
@@ -818,33 +1136,33 @@ private:
       }
       break;
     case senjo::West:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::West: case senjo::East: return false;
       default:
         sqr = (from + senjo::West);
         if (type == Move::EnPassant) {
-          switch (from.DirectionTo(to)) {
+          switch (StepToward(from.Name(), to.Name())) {
           case senjo::SouthWest: case senjo::NorthWest: sqr += senjo::West;
           default:
             break;
           }
         }
         for (; sqr.IsValid(); sqr += senjo::West) {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
         }
         sqr = (from + senjo::East);
         if (type == Move::EnPassant) {
-          switch (from.DirectionTo(to)) {
+          switch (StepToward(from.Name(), to.Name())) {
           case senjo::SouthEast: case senjo::NorthEast: sqr += senjo::East;
           default:
             break;
           }
         }
         for (; sqr.IsValid(); sqr += senjo::East) {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Rook)) || (piece == ((!color)|Queen))) {
           return true;
@@ -852,33 +1170,33 @@ private:
       }
       break;
     case senjo::East:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::West: case senjo::East: return false;
       default:
         sqr = (from + senjo::East);
         if (type == Move::EnPassant) {
-          switch (from.DirectionTo(to)) {
+          switch (StepToward(from.Name(), to.Name())) {
           case senjo::SouthEast: case senjo::NorthEast: sqr += senjo::East;
           default:
             break;
           }
         }
         for (; sqr.IsValid(); sqr += senjo::East) {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
         }
         sqr = (from + senjo::West);
         if (type == Move::EnPassant) {
-          switch (from.DirectionTo(to)) {
+          switch (StepToward(from.Name(), to.Name())) {
           case senjo::SouthWest: case senjo::NorthWest: sqr += senjo::West;
           default:
             break;
           }
         }
         for (; sqr.IsValid(); sqr += senjo::West) {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Rook)) || (piece == ((!color)|Queen))) {
           return true;
@@ -886,13 +1204,13 @@ private:
       }
       break;
     case senjo::NorthWest:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::SouthEast: case senjo::NorthWest: return false;
       default:
         for (sqr = (from + senjo::NorthWest); sqr.IsValid();
              sqr += senjo::NorthWest)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -900,7 +1218,7 @@ private:
         for (sqr = (from + senjo::SouthEast); sqr.IsValid();
              sqr += senjo::SouthEast)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Bishop)) || (piece == ((!color)|Queen))) {
           return true;
@@ -908,13 +1226,13 @@ private:
       }
       break;
     case senjo::North:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::South: case senjo::North: return false;
       default:
         for (sqr = (from + senjo::North); sqr.IsValid();
              sqr += senjo::North)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -922,7 +1240,7 @@ private:
         for (sqr = (from + senjo::South); sqr.IsValid();
              sqr += senjo::South)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Rook)) || (piece == ((!color)|Queen))) {
           return true;
@@ -930,13 +1248,13 @@ private:
       }
       break;
     case senjo::NorthEast:
-      switch (from.DirectionTo(to)) {
+      switch (StepToward(from.Name(), to.Name())) {
       case senjo::SouthWest: case senjo::NorthEast: return false;
       default:
         for (sqr = (from + senjo::NorthEast); sqr.IsValid();
              sqr += senjo::NorthEast)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if (piece != (color|King)) {
           return false;
@@ -944,7 +1262,7 @@ private:
         for (sqr = (from + senjo::SouthWest); sqr.IsValid();
              sqr += senjo::SouthWest)
         {
-          if ((piece = _board[sqr.Name()])) break;
+          if ((piece = board[sqr.Name()])) break;
         }
         if ((piece == ((!color)|Bishop)) || (piece == ((!color)|Queen))) {
           return true;
@@ -965,6 +1283,213 @@ private:
     return Pinned<color>(move.GetFrom(), move.GetTo(), move.GetType());
   }
 
+  //--------------------------------------------------------------------------
+  //! Does the given move put the enemy king in check?
+  //! If 'prepass' is true discovered checks are detected with the results of
+  //! FindChecksAndPins(), which must be current for the position at this node
+  //--------------------------------------------------------------------------
+  template<Color color, bool prepass>
+  inline bool GivesCheck(const int from,
+                         const int to,
+                         const Move::MoveType mtype,
+                         const int pc,
+                         const int promo) const
+  {
+    const int kingSqr = king[!color];
+    switch (mtype) {
+    case Move::EnPassant:
+    case Move::CastleShort:
+    case Move::CastleLong:
+      return SpecialMoveGivesCheck<color>(from, to, mtype);
+    default:
+      break;
+    }
+
+    // direct check by the moved (or promoted) piece
+    const int piece = (promo ? promo : pc);
+    if ((piece < King) && CanAttack(piece, to, kingSqr)) {
+      if (piece < Bishop) {
+        return true;
+      }
+      const int step = StepToward(to, kingSqr);
+      int sqr = (to + step);
+      while ((sqr != kingSqr) && (!board[sqr] || (sqr == from))) {
+        sqr += step;
+      }
+      if (sqr == kingSqr) {
+        return true;
+      }
+    }
+
+    // discovered check
+    return prepass
+        ? LeavesLine(discoCount, disco, discoStep, from, to)
+        : Pinned<!color>(senjo::Square(from), senjo::Square(to), mtype);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Does the given castle or en passant move put the enemy king in check?
+  //! These move or remove two pieces, so they're tested on the board after
+  //! temporarily making the move.
+  //--------------------------------------------------------------------------
+  template<Color color>
+  bool SpecialMoveGivesCheck(const int from,
+                             const int to,
+                             const Move::MoveType mtype) const
+  {
+    const int kingSqr = king[!color];
+    bool check;
+    if (mtype == Move::EnPassant) {
+      const int capSqr = (to + (color ? senjo::North : senjo::South));
+      board[from] = 0;
+      board[to] = (color|Pawn);
+      board[capSqr] = 0;
+      check = AttackedBy<color>(senjo::Square(kingSqr));
+      board[capSqr] = ((!color)|Pawn);
+      board[to] = 0;
+      board[from] = (color|Pawn);
+      return check;
+    }
+
+    const bool castleShort = (mtype == Move::CastleShort);
+    const int rookFrom = (castleShort ? (to + senjo::East) : (to - 2));
+    const int rookTo = (castleShort ? (to + senjo::West) : (to + senjo::East));
+    board[from] = 0;
+    board[rookFrom] = 0;
+    board[to] = (color|King);
+    board[rookTo] = (color|Rook);
+    check = AttackedBy<color>(senjo::Square(kingSqr));
+    if (!check && CanAttack((color|Rook), rookTo, kingSqr)) {
+      const int step = StepToward(rookTo, kingSqr);
+      int sqr = (rookTo + step);
+      while ((sqr != kingSqr) && !board[sqr]) {
+        sqr += step;
+      }
+      check = (sqr == kingSqr);
+    }
+    board[rookTo] = 0;
+    board[to] = 0;
+    board[rookFrom] = (color|Rook);
+    board[from] = (color|King);
+    return check;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Find the pieces giving check and the pieces pinned to our king
+  //! Must be called before generating moves at this node, move generators
+  //! use BreaksPin() instead of testing each move with Pinned().
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline void FindChecksAndPins() {
+    const char* pieces = td->pieceList[!color];
+    const int kingSqr = king[color];
+    int between;
+    int from;
+    int pc;
+    int pin;
+    int sqr;
+    int step;
+
+    checkCount = pinCount = 0;
+    for (int i = 0; i < td->listSize[!color]; ++i) {
+      from = pieces[i];
+      pc = board[from];
+      assert(pc && (COLOR_OF(pc) != color));
+      if ((pc >= King) || !CanAttack(pc, from, kingSqr)) {
+        continue;
+      }
+      if (pc < Bishop) {
+        assert(checkCount < 2);
+        checker[checkCount++] = from;
+        continue;
+      }
+      step = StepToward(kingSqr, from);
+      between = 0;
+      pin = 0;
+      for (sqr = (kingSqr + step); sqr != from; sqr += step) {
+        if (board[sqr]) {
+          if ((++between > 1) || (COLOR_OF(board[sqr]) != color)) {
+            between = 2;
+            break;
+          }
+          pin = sqr;
+        }
+      }
+      if (!between) {
+        assert(checkCount < 2);
+        checker[checkCount++] = from;
+      }
+      else if (between == 1) {
+        assert(pinCount < 8);
+        pinned[pinCount] = pin;
+        pinStep[pinCount++] = step;
+      }
+    }
+    checkState = (checkCount ? IsInCheck : NotInCheck);
+
+    // find our pieces that give discovered check by leaving the line
+    // between one of our sliders and the enemy king
+    const int enemyKing = king[!color];
+    pieces = td->pieceList[color];
+    discoCount = 0;
+    for (int i = 0; i < td->listSize[color]; ++i) {
+      from = pieces[i];
+      pc = board[from];
+      if ((pc < Bishop) || (pc >= King) || !CanAttack(pc, from, enemyKing)) {
+        continue;
+      }
+      step = StepToward(enemyKing, from);
+      between = 0;
+      pin = 0;
+      for (sqr = (enemyKing + step); sqr != from; sqr += step) {
+        if (board[sqr]) {
+          if ((++between > 1) || (COLOR_OF(board[sqr]) != color)) {
+            between = 2;
+            break;
+          }
+          pin = sqr;
+        }
+      }
+      if (between == 1) {
+        assert(discoCount < 8);
+        disco[discoCount] = pin;
+        discoStep[discoCount++] = step;
+      }
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Does moving from \p from to \p to leave the line through \p from?
+  //! \param count Number of entries in \p sqrs and \p steps
+  //! \param sqrs Squares of pieces that are on a line of interest
+  //! \param steps Direction of the line through each square in \p sqrs
+  //--------------------------------------------------------------------------
+  static inline bool LeavesLine(const int count,
+                                const char* sqrs,
+                                const char* steps,
+                                const int from,
+                                const int to)
+  {
+    for (int i = 0; i < count; ++i) {
+      if (sqrs[i] == from) {
+        const int step = StepToward(from, to);
+        return ((step != steps[i]) && (step != -steps[i]));
+      }
+    }
+    return false;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Would moving the piece on \p from to \p to expose our king?
+  //! Uses the pins found by FindChecksAndPins(), so this doesn't cover the
+  //! en passant case of both pawns leaving the king's rank.
+  //--------------------------------------------------------------------------
+  inline bool BreaksPin(const senjo::Square& from,
+                        const senjo::Square& to) const
+  {
+    return LeavesLine(pinCount, pinned, pinStep, from.Name(), to.Name());
+  }
+
   //--------------------------------------------------------------------------
   //! Generate moves that stop check (if in check)
   //! \return false if not in check and therefore no moves generated
@@ -982,10 +1507,9 @@ private:
       senjo::North,       senjo::NorthEast
     };
 
-    int attackers = 0;
     int piece;
     int squareCount = 0;
-    int squares[40];
+    int squares[16];
     int tmp;
     int xray[2] = {-1,-1};
     int xrayCount = 0;
@@ -994,92 +1518,44 @@ private:
     senjo::Square    from = king[color];
     senjo::Square    to;
 
-    // find pieces giving check and the squares between them and the king
-    for (int i = 0; i < 16; ++i) {
-      if (!(to = (from + (direction = DIRECTIONS[i])))) {
-        continue;
-      }
-      switch (direction) {
-      case senjo::KnightMove1: case senjo::KnightMove2:
-      case senjo::KnightMove3: case senjo::KnightMove4:
-      case senjo::KnightMove5: case senjo::KnightMove6:
-      case senjo::KnightMove7: case senjo::KnightMove8:
-        if (_board[to.Name()] == ((!color)|Knight)) {
-          attackers++;
-          squares[squareCount++] = to.Name();
-        }
-        break;
-      case senjo::SouthWest: case senjo::SouthEast:
-      case senjo::NorthWest: case senjo::NorthEast:
-        switch ((piece = _board[to.Name()])) {
-        case ((!color)|Pawn):
-          if (color ? (direction < 0) : (direction > 0)) {
-            attackers++;
-            squares[squareCount++] = to.Name();
-          }
-          break;
-        case ((!color)|Bishop): case ((!color)|Queen):
-          attackers++;
-          assert(xrayCount < 2);
-          xray[xrayCount++] = (from - direction).Name();
-          squares[squareCount++] = to.Name();
-          break;
-        default:
-          squares[(tmp = squareCount)++] = to.Name();
-          while (!piece && (to += direction).IsValid()) {
-            squares[tmp++] = to.Name();
-            switch ((piece = _board[to.Name()])) {
-            case ((!color)|Bishop): case ((!color)|Queen):
-              attackers++;
-              assert(xrayCount < 2);
-              xray[xrayCount++] = (from - direction).Name();
-              squareCount = tmp;
-              break;
-            }
-          }
+    // get squares between the king and the pieces giving check (found by
+    // FindChecksAndPins) and the squares behind the king that they x-ray
+    for (int i = 0; i < checkCount; ++i) {
+      to = checker[i];
+      if (board[to.Name()] >= Bishop) {
+        direction = static_cast<senjo::Direction>(
+            StepToward(from.Name(), to.Name()));
+        xray[xrayCount++] = (from - direction).Name();
+        for (tmp = (from.Name() + direction); tmp != to.Name();
+             tmp += direction)
+        {
+          squares[squareCount++] = tmp;
         }
-        break;
-      case senjo::South: case senjo::West:
-      case senjo::East: case senjo::North:
-        tmp = squareCount;
-        do {
-          squares[tmp++] = to.Name();
-          switch ((piece = _board[to.Name()])) {
-          case ((!color)|Rook): case ((!color)|Queen):
-            attackers++;
-            assert(xrayCount < 2);
-            xray[xrayCount++] = (from - direction).Name();
-            squareCount = tmp;
-            break;
-          }
-        } while (!piece && (to += direction).IsValid());
-        break;
-      case senjo::Unknown:
-        break;
       }
+      squares[squareCount++] = to.Name();
     }
 
-    switch (attackers) {
+    switch (checkCount) {
     case 0:
-      checkState = NotInCheck;
+      assert(checkState == NotInCheck);
       return false;
     case 1:
       // get non-king moves that block or capture the piece giving check
       for (tmp = 0; tmp < squareCount; ++tmp) {
         to = squares[tmp];
-        if ((_board[to.Name()] == ((!color)|Pawn)) &&
+        if ((board[to.Name()] == ((!color)|Pawn)) &&
             (ep == (to + (color ? senjo::South : senjo::North))))
         {
           if ((from = (ep + (color ? senjo::NorthWest
                                    : senjo::SouthWest))).IsValid() &&
-              (_board[from.Name()] == (color|Pawn)) &&
+              (board[from.Name()] == (color|Pawn)) &&
               !Pinned<color>(from, ep, Move::EnPassant))
           {
             AddMove<color>(from, ep, Move::EnPassant, ((!color)|Pawn));
           }
           if ((from = (ep + (color ? senjo::NorthEast
                                    : senjo::SouthEast))).IsValid() &&
-              (_board[from.Name()] == (color|Pawn)) &&
+              (board[from.Name()] == (color|Pawn)) &&
               !Pinned<color>(from, ep, Move::EnPassant))
           {
             AddMove<color>(from, ep, Move::EnPassant, ((!color)|Pawn));
@@ -1096,46 +1572,46 @@ private:
           case senjo::KnightMove3: case senjo::KnightMove4:
           case senjo::KnightMove5: case senjo::KnightMove6:
           case senjo::KnightMove7: case senjo::KnightMove8:
-            if ((_board[from.Name()] == (color|Knight)) &&
-                !Pinned<color>(from, to, Move::Normal))
+            if ((board[from.Name()] == (color|Knight)) &&
+                !BreaksPin(from, to))
             {
-              AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+              AddMove<color>(from, to, Move::Normal, board[to.Name()]);
             }
             break;
           case senjo::SouthWest: case senjo::SouthEast:
           case senjo::NorthWest: case senjo::NorthEast:
-            switch ((piece = _board[from.Name()])) {
+            switch ((piece = board[from.Name()])) {
             case (color|Pawn):
               if ((color ? (direction > 0) : (direction < 0)) &&
-                  _board[to.Name()] && !Pinned<color>(from, to, Move::Normal))
+                  board[to.Name()] && !BreaksPin(from, to))
               {
                 if (to.Y() == (color ? 0 : 7)) {
-                  AddMove<color>(from, to, Move::PawnCapture, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnCapture, board[to.Name()],
                       (color|Queen));
-                  AddMove<color>(from, to, Move::PawnCapture, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnCapture, board[to.Name()],
                       (color|Rook));
-                  AddMove<color>(from, to, Move::PawnCapture, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnCapture, board[to.Name()],
                       (color|Bishop));
-                  AddMove<color>(from, to, Move::PawnCapture, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnCapture, board[to.Name()],
                       (color|Knight));
                 }
                 else {
                   AddMove<color>(from, to, Move::PawnCapture,
-                                 _board[to.Name()]);
+                                 board[to.Name()]);
                 }
               }
               break;
             case (color|Bishop): case (color|Queen):
-              if (!Pinned<color>(from, to, Move::Normal)) {
-                AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+              if (!BreaksPin(from, to)) {
+                AddMove<color>(from, to, Move::Normal, board[to.Name()]);
               }
               break;
             default:
               while (!piece && (from += direction).IsValid()) {
-                switch ((piece = _board[from.Name()])) {
+                switch ((piece = board[from.Name()])) {
                 case (color|Bishop): case (color|Queen):
-                  if (!Pinned<color>(from, to, Move::Normal)) {
-                    AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+                  if (!BreaksPin(from, to)) {
+                    AddMove<color>(from, to, Move::Normal, board[to.Name()]);
                   }
                   break;
                 }
@@ -1143,46 +1619,46 @@ private:
             }
             break;
           case senjo::South: case senjo::North:
-            switch ((piece = _board[from.Name()])) {
+            switch ((piece = board[from.Name()])) {
             case (color|Pawn):
               if ((color ? (direction > 0) : (direction < 0)) &&
-                  !_board[to.Name()] && !Pinned<color>(from, to, Move::Normal))
+                  !board[to.Name()] && !BreaksPin(from, to))
               {
                 if (to.Y() == (color ? 0 : 7)) {
-                  AddMove<color>(from, to, Move::PawnPush, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnPush, board[to.Name()],
                       (color|Queen));
-                  AddMove<color>(from, to, Move::PawnPush, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnPush, board[to.Name()],
                       (color|Rook));
-                  AddMove<color>(from, to, Move::PawnPush, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnPush, board[to.Name()],
                       (color|Bishop));
-                  AddMove<color>(from, to, Move::PawnPush, _board[to.Name()],
+                  AddMove<color>(from, to, Move::PawnPush, board[to.Name()],
                       (color|Knight));
                 }
                 else {
-                  AddMove<color>(from, to, Move::PawnPush, _board[to.Name()]);
+                  AddMove<color>(from, to, Move::PawnPush, board[to.Name()]);
                 }
               }
               break;
             case (color|Rook): case (color|Queen):
-              if (!Pinned<color>(from, to, Move::Normal)) {
-                AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+              if (!BreaksPin(from, to)) {
+                AddMove<color>(from, to, Move::Normal, board[to.Name()]);
               }
               break;
             default:
               while (!piece && (from += direction).IsValid()) {
-                switch ((piece = _board[from.Name()])) {
+                switch ((piece = board[from.Name()])) {
                 case (color|Pawn):
                   if ((to.Y() == (color ? 4 : 3)) &&
                       (from.Y() == (color ? 6 : 1)) &&
-                      !_board[to.Name()] &&
-                      !Pinned<color>(from, to, Move::Normal))
+                      !board[to.Name()] &&
+                      !BreaksPin(from, to))
                   {
-                    AddMove<color>(from, to, Move::PawnLung, _board[to.Name()]);
+                    AddMove<color>(from, to, Move::PawnLung, board[to.Name()]);
                   }
                   break;
                 case (color|Rook): case (color|Queen):
-                  if (!Pinned<color>(from, to, Move::Normal)) {
-                    AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+                  if (!BreaksPin(from, to)) {
+                    AddMove<color>(from, to, Move::Normal, board[to.Name()]);
                   }
                   break;
                 }
@@ -1191,10 +1667,10 @@ private:
             break;
           case senjo::West: case senjo::East:
             do {
-              switch ((piece = _board[from.Name()])) {
+              switch ((piece = board[from.Name()])) {
               case (color|Rook): case (color|Queen):
-                if (!Pinned<color>(from, to, Move::Normal)) {
-                  AddMove<color>(from, to, Move::Normal, _board[to.Name()]);
+                if (!BreaksPin(from, to)) {
+                  AddMove<color>(from, to, Move::Normal, board[to.Name()]);
                 }
                 break;
               }
@@ -1214,7 +1690,7 @@ private:
             (to.Name() != xray[0]) && (to.Name() != xray[1]) &&
             !AttackedBy<!color>(to))
         {
-          switch ((piece = _board[to.Name()])) {
+          switch ((piece = board[to.Name()])) {
           case 0:
           case ((!color)|Pawn):
           case ((!color)|Knight):
@@ -1248,9 +1724,9 @@ private:
     senjo::Square to;
     for (int i = 0; i < 2; ++i) {
       if ((to = (from + DIRECTIONS[i])).IsValid() &&
-          !Pinned<color>(from, to, Move::PawnCapture))
+          !BreaksPin(from, to))
       {
-        switch ((cap = _board[to.Name()])) {
+        switch ((cap = board[to.Name()])) {
         case ((!color)|Knight):
         case ((!color)|Bishop):
         case ((!color)|Rook):
@@ -1266,7 +1742,7 @@ private:
       }
     }
     if ((to = (from + (color ? senjo::South : senjo::North))).IsValid() &&
-        !_board[to.Name()] && !Pinned<color>(from, to, Move::PawnPush))
+        !board[to.Name()] && !BreaksPin(from, to))
     {
       AddMove<color>(from, to, Move::PawnPush, 0, (color|Queen));
       if (underpromote) {
@@ -1296,8 +1772,8 @@ private:
             AddMove<color>(from, to, Move::EnPassant, ((!color)|Pawn));
           }
         }
-        else if (!Pinned<color>(from, to, Move::PawnCapture)) {
-          switch ((cap = _board[to.Name()])) {
+        else if (!BreaksPin(from, to)) {
+          switch ((cap = board[to.Name()])) {
           case ((!color)|Pawn):
           case ((!color)|Knight):
           case ((!color)|Bishop):
@@ -1318,7 +1794,7 @@ private:
   inline void GetPawnChecks(const senjo::Square& from) {
     senjo::Square to;
     if (!(to = (from + (color ? senjo::South : senjo::North))) ||
-        _board[to.Name()] || Pinned<color>(from, to, Move::PawnPush))
+        board[to.Name()] || BreaksPin(from, to))
     {
       return;
     }
@@ -1330,7 +1806,7 @@ private:
     }
     if ((from.Y() != (color ? 6 : 1)) ||
         !(to += (color ? senjo::South : senjo::North)) ||
-        _board[to.Name()])
+        board[to.Name()])
     {
       return;
     }
@@ -1349,14 +1825,14 @@ private:
   inline void GetPawnMoves(const senjo::Square& from) {
     senjo::Square to;
     if (!(to = (from + (color ? senjo::South : senjo::North))) ||
-        _board[to.Name()] || Pinned<color>(from, to, Move::PawnPush))
+        board[to.Name()] || BreaksPin(from, to))
     {
       return;
     }
     AddMove<color>(from, to, Move::PawnPush);
     if ((from.Y() == (color ? 6 : 1)) &&
         (to += (color ? senjo::South : senjo::North)).IsValid() &&
-        !_board[to.Name()])
+        !board[to.Name()])
     {
       AddMove<color>(from, to, Move::PawnLung);
     }
@@ -1378,12 +1854,13 @@ private:
     senjo::Square to;
     for (int i = 0; i < 8; ++i) {
       if ((to = (from + DIRECTIONS[i])).IsValid() &&
-          !Pinned<color>(from, to, Move::Normal))
+          !BreaksPin(from, to))
       {
-        switch ((cap = _board[to.Name()])) {
+        switch ((cap = board[to.Name()])) {
         case 0:
-          if ((type == AllMoves) || ((type == CapsAndChecks) &&
-                                     Pinned<!color>(from, to, Move::Normal)))
+          if ((type == AllMoves) || (type == QuietMoves) ||
+              ((type == CapsAndChecks) &&
+               Pinned<!color>(from, to, Move::Normal)))
           {
             AddMove<color>(from, to, Move::Normal);
           }
@@ -1393,7 +1870,9 @@ private:
         case ((!color)|Bishop):
         case ((!color)|Rook):
         case ((!color)|Queen):
-          AddMove<color>(from, to, Move::Normal, cap);
+          if (type != QuietMoves) {
+            AddMove<color>(from, to, Move::Normal, cap);
+          }
           break;
         }
       }
@@ -1416,21 +1895,23 @@ private:
     for (int i = 0; i < 4; ++i) {
       discovered = 0;
       if ((to = (from + DIRECTIONS[i])).IsValid() &&
-          !Pinned<color>(from, to, Move::Normal)) do
+          !BreaksPin(from, to)) do
       {
-        if ((cap = _board[to.Name()])) {
+        if ((cap = board[to.Name()])) {
           switch (cap) {
           case ((!color)|Pawn):
           case ((!color)|Knight):
           case ((!color)|Bishop):
           case ((!color)|Rook):
           case ((!color)|Queen):
-            AddMove<color>(from, to, Move::Normal, cap);
+            if (type != QuietMoves) {
+              AddMove<color>(from, to, Move::Normal, cap);
+            }
             break;
           }
           break;
         }
-        else if (type == AllMoves) {
+        else if ((type == AllMoves) || (type == QuietMoves)) {
           AddMove<color>(from, to, Move::Normal);
         }
         else if (type == CapsAndChecks) {
@@ -1461,21 +1942,23 @@ private:
     for (int i = 0; i < 4; ++i) {
       discovered = 0;
       if ((to = (from + DIRECTIONS[i])).IsValid() &&
-          !Pinned<color>(from, to, Move::Normal)) do
+          !BreaksPin(from, to)) do
       {
-        if ((cap = _board[to.Name()])) {
+        if ((cap = board[to.Name()])) {
           switch (cap) {
           case ((!color)|Pawn):
           case ((!color)|Knight):
           case ((!color)|Bishop):
           case ((!color)|Rook):
           case ((!color)|Queen):
-            AddMove<color>(from, to, Move::Normal, cap);
+            if (type != QuietMoves) {
+              AddMove<color>(from, to, Move::Normal, cap);
+            }
             break;
           }
           break;
         }
-        else if (type == AllMoves) {
+        else if ((type == AllMoves) || (type == QuietMoves)) {
           AddMove<color>(from, to, Move::Normal);
         }
         else if (type == CapsAndChecks) {
@@ -1508,21 +1991,23 @@ private:
     for (int i = 0; i < 8; ++i) {
       discovered = 0;
       if ((to = (from + DIRECTIONS[i])).IsValid() &&
-          !Pinned<color>(from, to, Move::Normal)) do
+          !BreaksPin(from, to)) do
       {
-        if ((cap = _board[to.Name()])) {
+        if ((cap = board[to.Name()])) {
           switch (cap) {
           case ((!color)|Pawn):
           case ((!color)|Knight):
           case ((!color)|Bishop):
           case ((!color)|Rook):
           case ((!color)|Queen):
-            AddMove<color>(from, to, Move::Normal, cap);
+            if (type != QuietMoves) {
+              AddMove<color>(from, to, Move::Normal, cap);
+            }
             break;
           }
           break;
         }
-        else if (type == AllMoves) {
+        else if ((type == AllMoves) || (type == QuietMoves)) {
           AddMove<color>(from, to, Move::Normal);
         }
         else if (type == CapsAndChecks) {
@@ -1553,13 +2038,13 @@ private:
     senjo::Square to;
     if (from == (color ? senjo::Square::E8 : senjo::Square::E1)) {
       if ((state & (color ? BlackShort : WhiteShort)) &&
-          !_board[color ? senjo::Square::F8 : senjo::Square::F1] &&
-          !_board[color ? senjo::Square::G8 : senjo::Square::G1] &&
+          !board[color ? senjo::Square::F8 : senjo::Square::F1] &&
+          !board[color ? senjo::Square::G8 : senjo::Square::G1] &&
           !AttackedBy<!color>(color ? senjo::Square::E8 : senjo::Square::E1) &&
           !AttackedBy<!color>(color ? senjo::Square::F8 : senjo::Square::F1) &&
           !AttackedBy<!color>(color ? senjo::Square::G8 : senjo::Square::G1))
       {
-        if (type == AllMoves) {
+        if ((type == AllMoves) || (type == QuietMoves)) {
           to = (color ? senjo::Square::G8 : senjo::Square::G1);
           AddMove<color>(from, to, Move::CastleShort);
         }
@@ -1568,14 +2053,14 @@ private:
         }
       }
       if ((state & (color ? BlackLong : WhiteLong)) &&
-          !_board[color ? senjo::Square::B8 : senjo::Square::B1] &&
-          !_board[color ? senjo::Square::C8 : senjo::Square::C1] &&
-          !_board[color ? senjo::Square::D8 : senjo::Square::D1] &&
+          !board[color ? senjo::Square::B8 : senjo::Square::B1] &&
+          !board[color ? senjo::Square::C8 : senjo::Square::C1] &&
+          !board[color ? senjo::Square::D8 : senjo::Square::D1] &&
           !AttackedBy<!color>(color ? senjo::Square::C8 : senjo::Square::C1) &&
           !AttackedBy<!color>(color ? senjo::Square::D8 : senjo::Square::D1) &&
           !AttackedBy<!color>(color ? senjo::Square::E8 : senjo::Square::E1))
       {
-        if (type == AllMoves) {
+        if ((type == AllMoves) || (type == QuietMoves)) {
           to = (color ? senjo::Square::C8 : senjo::Square::C1);
           AddMove<color>(from, to, Move::CastleLong);
         }
@@ -1586,10 +2071,11 @@ private:
     }
     for (int i = 0; i < 8; ++i) {
       if ((to = (from + DIRECTIONS[i])).IsValid() && !AttackedBy<!color>(to)) {
-        switch ((cap = _board[to.Name()])) {
+        switch ((cap = board[to.Name()])) {
         case 0:
-          if ((type == AllMoves) || ((type == CapsAndChecks) &&
-                                     Pinned<!color>(from, to, Move::KingMove)))
+          if ((type == AllMoves) || (type == QuietMoves) ||
+              ((type == CapsAndChecks) &&
+               Pinned<!color>(from, to, Move::KingMove)))
           {
             AddMove<color>(from, to, Move::KingMove);
           }
@@ -1599,13 +2085,30 @@ private:
         case ((!color)|Bishop):
         case ((!color)|Rook):
         case ((!color)|Queen):
-          AddMove<color>(from, to, Move::KingMove, cap);
+          if (type != QuietMoves) {
+            AddMove<color>(from, to, Move::KingMove, cap);
+          }
           break;
         }
       }
     }
   }
 
+  //--------------------------------------------------------------------------
+  //! Empty this node's 'moves' array and place it in the move arena
+  //! The list begins where the parent's list ends, so the arena only grows
+  //! as deep as the lists on the current search path actually are.
+  //--------------------------------------------------------------------------
+  inline void ClearMoves() {
+    if (parent) {
+      moves = (parent->moves + parent->moveCount);
+    }
+    else {
+      moves = td->moves;
+    }
+    moveIndex = moveCount = 0;
+  }
+
   //--------------------------------------------------------------------------
   //! Add legal moves to this node's 'moves' array
   //! If 'qsearch' template parameter is true only volatile moves are generated
@@ -1613,16 +2116,20 @@ private:
   template<Color color, bool qsearch>
   inline void GenerateMoves(const int depth) {
     assert(color == ColorToMove());
-    moveIndex = moveCount = 0;
+    ClearMoves();
 
+    const char* pieces = td->pieceList[color];
+    const int count = td->listSize[color];
     senjo::Square from;
-    if ((checkState != NotInCheck) && GetCheckEvasions<color>()) {
+    FindChecksAndPins<color>();
+    if (checkCount && GetCheckEvasions<color>()) {
       return;
     }
     else if (!qsearch) {
       // generate all moves
-      for (from = senjo::Square::A1; from.IsValid(); ++from) {
-        switch (_board[from.Name()]) {
+      for (int i = 0; i < count; ++i) {
+        from = pieces[i];
+        switch (board[from.Name()]) {
         case (color|Pawn):
           if (from.Y() == (color ? 1 : 6)) {
             GetPromos<color, true>(from); // <color, underpromote=true>
@@ -1642,8 +2149,9 @@ private:
     }
     else if (depth < 0) {
       // quiescence search, no quiet checks
-      for (from = senjo::Square::A1; from.IsValid(); ++from) {
-        switch (_board[from.Name()]) {
+      for (int i = 0; i < count; ++i) {
+        from = pieces[i];
+        switch (board[from.Name()]) {
         case (color|Pawn):
           if (from.Y() == (color ? 1 : 6)) {
             GetPromos<color, false>(from); // <color, underpromote=false>
@@ -1662,8 +2170,9 @@ private:
     }
     else {
       // quiescence search, plus quiet checks
-      for (from = senjo::Square::A1; from.IsValid(); ++from) {
-        switch (_board[from.Name()]) {
+      for (int i = 0; i < count; ++i) {
+        from = pieces[i];
+        switch (board[from.Name()]) {
         case (color|Pawn):
           if (from.Y() == (color ? 1 : 6)) {
             GetPromos<color, false>(from); // <color, underpromote=false>
@@ -1684,17 +2193,171 @@ private:
   }
 
   //--------------------------------------------------------------------------
-  //! Get endgame multiplier (ratio to use on endgame-only score values)
+  //! Append legal captures and promotions to this node's 'moves' array
   //--------------------------------------------------------------------------
-  inline float EndGame(const Color color) const {
-    return (static_cast<float>(StartMaterial-material[!color])/StartMaterial);
+  template<Color color>
+  inline void GenerateCaptures() {
+    const char* pieces = td->pieceList[color];
+    const int count = td->listSize[color];
+    senjo::Square from;
+    for (int i = 0; i < count; ++i) {
+      from = pieces[i];
+      switch (board[from.Name()]) {
+      case (color|Pawn):
+        if (from.Y() == (color ? 1 : 6)) {
+          GetPromos<color, true>(from); // <color, underpromote=true>
+        }
+        else {
+          GetPawnCaps<color>(from);
+        }
+        break;
+      case (color|Knight): GetKnightMoves <color, Captures>(from); break;
+      case (color|Bishop): GetBishopMoves <color, Captures>(from); break;
+      case (color|Rook):   GetRookMoves   <color, Captures>(from); break;
+      case (color|Queen):  GetQueenMoves  <color, Captures>(from); break;
+      case (color|King):   GetKingMoves   <color, Captures>(from); break;
+      }
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Append legal non-capture, non-promotion moves to this node's 'moves'
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline void GenerateQuiets() {
+    const char* pieces = td->pieceList[color];
+    const int count = td->listSize[color];
+    senjo::Square from;
+    for (int i = 0; i < count; ++i) {
+      from = pieces[i];
+      switch (board[from.Name()]) {
+      case (color|Pawn):
+        if (from.Y() != (color ? 1 : 6)) {
+          GetPawnMoves<color>(from);
+        }
+        break;
+      case (color|Knight): GetKnightMoves <color, QuietMoves>(from); break;
+      case (color|Bishop): GetBishopMoves <color, QuietMoves>(from); break;
+      case (color|Rook):   GetRookMoves   <color, QuietMoves>(from); break;
+      case (color|Queen):  GetQueenMoves  <color, QuietMoves>(from); break;
+      case (color|King):   GetKingMoves   <color, QuietMoves>(from); break;
+      }
+    }
   }
 
   //--------------------------------------------------------------------------
-  //! Get midgame multiplier (ratio to use on midgame-only score values)
+  //! Append a killer move to this node's 'moves' array if it is legal here
+  //! \return The appended move or NULL if \p move isn't legal
   //--------------------------------------------------------------------------
-  inline float MidGame(const Color color) const {
-    return (static_cast<float>(material[!color]) / StartMaterial);
+  template<Color color>
+  inline Move* AddKillerMove(const Move& move) {
+    assert(moveCount < MaxMoves);
+    Move& killer = moves[moveCount];
+    if (move.IsValid() &&
+        ExpandMove<color>(move.GetCompactBits(), 0, killer) &&
+        (killer == move))
+    {
+      moveIndex = ++moveCount;
+      return &killer;
+    }
+    return NULL;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Prepare for GetNextStagedMove() calls at this node
+  //! Check evasions are all generated up front, otherwise only captures and
+  //! promotions are generated now and the remaining moves on demand.
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline void StartMovePicker() {
+    assert(color == ColorToMove());
+    ClearMoves();
+    badCapIndex = badCapCount = 0;
+    FindChecksAndPins<color>();
+    if (checkCount && GetCheckEvasions<color>()) {
+      moveStage = Evasions;
+    }
+    else {
+      GenerateCaptures<color>();
+      moveStage = GoodCaps;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the next move in staged order: winning or even captures, killers,
+  //! quiet moves by history, then losing captures.
+  //! Each stage is generated only after the previous stage is exhausted.
+  //! \return NULL when there are no more moves
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline Move* GetNextStagedMove() {
+    Move* move;
+    switch (moveStage) {
+    case Evasions:
+      return GetNextMove();
+    case GoodCaps:
+      if (moveIndex < moveCount) {
+        move = SelectMove(moveIndex, moveCount);
+        if (move->GetScore() >= 0) {
+          return move;
+        }
+        badCapIndex = --moveIndex;
+        moveIndex = moveCount;
+      }
+      else {
+        badCapIndex = moveCount;
+      }
+      badCapCount = moveCount;
+      moveStage = Killer1;
+      // fall through
+    case Killer1:
+      moveStage = Killer2;
+      if ((move = AddKillerMove<color>(killer[0]))) {
+        return move;
+      }
+      // fall through
+    case Killer2:
+      moveStage = GenQuiets;
+      if ((move = AddKillerMove<color>(killer[1]))) {
+        return move;
+      }
+      // fall through
+    case GenQuiets:
+      GenerateQuiets<color>();
+      moveStage = Quiets;
+      // fall through
+    case Quiets:
+      while (moveIndex < moveCount) {
+        move = SelectMove(moveIndex, moveCount);
+        if (!IsKiller(*move)) {
+          return move;
+        }
+      }
+      moveStage = BadCaps;
+      // fall through
+    case BadCaps:
+      if (badCapIndex < badCapCount) {
+        return SelectMove(badCapIndex, badCapCount);
+      }
+      moveStage = NoMoreMoves;
+      // fall through
+    default:
+      return NULL;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Scale an endgame-only score value by how much material the enemy lost
+  //--------------------------------------------------------------------------
+  inline int EndGame(const Color color, const int value) const {
+    return (((StartMaterial - material[!color]) * value) / StartMaterial);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Scale a midgame-only score value by how much material the enemy has
+  //--------------------------------------------------------------------------
+  inline int MidGame(const Color color, const int value) const {
+    return ((material[!color] * value) / StartMaterial);
   }
 
   //--------------------------------------------------------------------------
@@ -1706,30 +2369,46 @@ private:
     if (pc < King) {
       return _PIECE_SQR[pc][sqr];
     }
-    const float mid = (MidGame(COLOR_OF(pc)) * _KING_SQR[sqr]);
-    const float end = (EndGame(COLOR_OF(pc)) * _KING_SQR[sqr + 8]);
-    return static_cast<int>(mid + end);
+    const int mid = (material[!COLOR_OF(pc)] * _KING_SQR[sqr]);
+    const int end = ((StartMaterial - material[!COLOR_OF(pc)]) *
+                     _KING_SQR[sqr + 8]);
+    return ((mid + end) / StartMaterial);
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Get the piece-square value of \p pc on \p sqr tracked by 'pst'
+  //! Only knights, bishops, rooks and queens are tracked.  Pawn values are
+  //! kept in the pawn hash table and king values are tapered by material
+  //! in KingEval(), so this returns 0 for those (and for empty squares).
+  //--------------------------------------------------------------------------
+  static inline int PstValue(const int pc, const int sqr) {
+    assert(senjo::Square(sqr).IsValid());
+    return ((pc >= Knight) && (pc < King)) ? _PIECE_SQR[pc][sqr] : 0;
   }
 
   //--------------------------------------------------------------------------
   //! Calculate the positional value of the pawn on the given square
+  //! The returned value does not include penalties for being blocked by a
+  //! non-pawn piece, those are added to the blocker list of \p entry.
   //--------------------------------------------------------------------------
   template<Color color>
-  inline int PawnEval(const senjo::Square& sqr) {
+  inline int PawnEval(const senjo::Square& sqr, PawnHashEntry& entry) {
     senjo::Square tmp;
     bool passed = true; // set to false below if not passed
     int score = SquareValue((color|Pawn), sqr.Name());
+    int blocked = 0; // penalty if blocked by a non-pawn piece
     const int x = sqr.X();
     const int y = sqr.Y();
+    const int front = (sqr.Name() + (color ? senjo::South : senjo::North));
 
-    openFile[color][x] = 0;
+    entry.openFile[color][x] = 0;
 
     // find nearest friendly pawn on left flank
     senjo::Square left;
     for (tmp = (sqr + senjo::West); tmp.IsValid();
          tmp += (color ? senjo::North : senjo::South))
     {
-      if (_board[tmp.Name()] == (color|Pawn)) {
+      if (board[tmp.Name()] == (color|Pawn)) {
         left = tmp;
         break;
       }
@@ -1740,7 +2419,7 @@ private:
     for (tmp = (sqr + senjo::East); tmp.IsValid();
          tmp += (color ? senjo::North : senjo::South))
     {
-      if (_board[tmp.Name()] == (color|Pawn)) {
+      if (board[tmp.Name()] == (color|Pawn)) {
         right = tmp;
         break;
       }
@@ -1750,8 +2429,14 @@ private:
     switch (sqr.Name()) {
     case (color ? senjo::Square::D7 : senjo::Square::D2):
     case (color ? senjo::Square::E7 : senjo::Square::E2):
-      if (_board[sqr.Name() + (color ? senjo::South : senjo::North)]) {
+      switch (board[front]) {
+      case (White|Pawn):
+      case (Black|Pawn):
         score -= 16;
+        break;
+      default:
+        blocked += 16;
+        break;
       }
       break;
     default:
@@ -1763,12 +2448,12 @@ private:
          passed && tmp.IsValid(); // passed var simply used to break the loop
          tmp += (color ? senjo::South : senjo::North))
     {
-      if (_board[tmp.Name()] == (color|Pawn)) {
+      if (board[tmp.Name()] == (color|Pawn)) {
         score -= 32;
         passed = false;
         break;
       }
-      if (_board[tmp.Name()] == ((!color)|Pawn)) {
+      if (board[tmp.Name()] == ((!color)|Pawn)) {
         passed = false;
         break;
       }
@@ -1783,7 +2468,7 @@ private:
         for (tmp = (sqr + (color ? senjo::SouthWest : senjo::NorthWest));
              tmp.IsValid(); tmp += (color ? senjo::North : senjo::South))
         {
-          if (_board[tmp.Name()] == ((!color)|Pawn)) {
+          if (board[tmp.Name()] == ((!color)|Pawn)) {
             leftOp = tmp;
             break;
           }
@@ -1793,7 +2478,7 @@ private:
         for (tmp = (sqr + (color ? senjo::SouthWest : senjo::NorthWest));
              tmp.IsValid(); tmp += (color ? senjo::North : senjo::South))
         {
-          if (_board[tmp.Name()] == ((!color)|Pawn)) {
+          if (board[tmp.Name()] == ((!color)|Pawn)) {
             rightOp = tmp;
             break;
           }
@@ -1816,7 +2501,7 @@ private:
         if (opFlanks) {
           bonus /= 2;
           passed = false; // allow backward pawn penalty
-          passers[sqr.Name()] = 1;
+          entry.passers[0] |= SquareBit(sqr.Name());
         }
 
         else {
@@ -1824,17 +2509,11 @@ private:
           if (diff > 0) {
             bonus += (bonus / 3);
           }
-          passers[sqr.Name()] = 2;
-        }
-
-        // reduce bonus if blocked
-        if ((tmp = (sqr + (color ? senjo::South : senjo::North))).IsValid() &&
-            _board[tmp.Name()])
-        {
-          bonus -= (bonus / 4);
-          passed = false; // allow backward pawn penalty
+          entry.passers[1] |= SquareBit(sqr.Name());
         }
 
+        // reduce bonus if blocked (only non-pawn pieces can block a passer)
+        blocked += (bonus / 4);
         score += bonus;
       }
       else {
@@ -1849,7 +2528,7 @@ private:
         score -= (2 * dist);
 
         // extra penalty if blocked by enemy knight or bishop
-        switch (_board[(sqr + (color ? senjo::South : senjo::North)).Name()]) {
+        switch (board[(sqr + (color ? senjo::South : senjo::North)).Name()]) {
         case ((!color)|Knight):
         case ((!color)|Bishop):
           score -= 8;
@@ -1860,6 +2539,54 @@ private:
       }
     }
 
+    if (blocked) {
+      assert(entry.blockCount < PawnHashEntry::MaxBlocks);
+      entry.blockSqr[entry.blockCount] = static_cast<uint8_t>(front);
+      entry.blockVal[entry.blockCount++] =
+          static_cast<int8_t>(color ? -blocked : blocked);
+    }
+
+    return score;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the pawn structure score (from white's perspective) and populate
+  //! the 'openFile' and 'passers' maps.  Results are kept in the pawn hash
+  //! table of the search thread so pawn evaluation is only done when the
+  //! pawn structure has not been seen recently.
+  //--------------------------------------------------------------------------
+  inline int PawnStructure() {
+    if (!pawnKey) {
+      memset(openFile, 1, sizeof(openFile));
+      passers[0] = passers[1] = 0;
+      return 0;
+    }
+
+    PawnHashEntry& entry = td->pawns[pawnKey & (ThreadData::PawnSlots - 1)];
+    if (entry.key != pawnKey) {
+      int score = 0;
+      memset(&entry, 0, sizeof(entry));
+      memset(entry.openFile, 1, sizeof(entry.openFile));
+      for (senjo::Square sqr = senjo::Square::A1; sqr.IsValid(); ++sqr) {
+        switch (board[sqr.Name()]) {
+        case (White|Pawn): score += PawnEval<White>(sqr, entry); break;
+        case (Black|Pawn): score -= PawnEval<Black>(sqr, entry); break;
+        }
+      }
+      entry.key = pawnKey;
+      entry.score = static_cast<int16_t>(score);
+    }
+
+    memcpy(openFile, entry.openFile, sizeof(openFile));
+    passers[0] = entry.passers[0];
+    passers[1] = entry.passers[1];
+
+    int score = entry.score;
+    for (int i = 0; i < entry.blockCount; ++i) {
+      if (board[entry.blockSqr[i]]) {
+        score -= entry.blockVal[i];
+      }
+    }
     return score;
   }
 
@@ -1868,7 +2595,7 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline int KnightEval(const senjo::Square& sqr) {
-    int score = SquareValue((color|Knight), sqr.Name());
+    int score = 0;
 
     // keep the knight close to the action
     // assuming the action is centered around the kings
@@ -1882,11 +2609,10 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline int BishopEval(const senjo::Square& sqr) {
-    int score = SquareValue((color|Bishop), sqr.Name());
+    int score = 0;
 
     // stay close to fiendly king during endgame
-    score += static_cast<int>(EndGame(color) *
-                              (2 * (8 - sqr.DistanceTo(king[color]))));
+    score += EndGame(color, (2 * (8 - sqr.DistanceTo(king[color]))));
 
     // bonus for being inline with enemy king
     switch (sqr.DirectionTo(king[!color])) {
@@ -1906,11 +2632,10 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline int RookEval(const senjo::Square& sqr) {
-    int score = SquareValue((color|Rook), sqr.Name());
+    int score = 0;
 
     // stay close to fiendly king during endgame
-    score += static_cast<int>(EndGame(color) *
-                              (2 * (8 - sqr.DistanceTo(king[color]))));
+    score += EndGame(color, (2 * (8 - sqr.DistanceTo(king[color]))));
 
     // bonus for being on an open or half-open file
     const int x = sqr.X();
@@ -1950,11 +2675,11 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   inline int QueenEval(const senjo::Square& sqr) {
-    int score = SquareValue((color|Queen), sqr.Name());
+    int score = 0;
 
     // the queen is almost an entirely tactical piece. There are some positional
     // rules of thumb that could be applied for the queen, but we'll just leave
-    // it up to the piece square table
+    // it up to the piece square table (see PstValue)
 
     return score;
   }
@@ -2001,7 +2726,7 @@ private:
       for (senjo::Square tmp(x, (color ? 6 : 1)); tmp.IsValid();
            tmp += (color ? senjo::South : senjo::North))
       {
-        switch (_board[tmp.Name()]) {
+        switch (board[tmp.Name()]) {
         case (color|Pawn):
           if (color ? (y >= tmp.Y()) : (y <= tmp.Y())) {
             val += (2 * (8 - sqr.DistanceTo(tmp)));
@@ -2027,7 +2752,7 @@ private:
     // TODO penalty for unprotected squares around king
 
     if (val) {
-      score += static_cast<int>(MidGame(color) * val);
+      score += MidGame(color, val);
     }
 
     // TODO endgame scoring
@@ -2037,6 +2762,54 @@ private:
     return score;
   }
 
+  //--------------------------------------------------------------------------
+  //! StaticEval() result when neither side has sufficient mating material
+  //--------------------------------------------------------------------------
+  enum { NoMatingMaterial = -0x8000 };
+
+  //--------------------------------------------------------------------------
+  //! \brief Get cached static evaluation of the position at this node
+  //! Only the piece counts used outside of evaluation are kept in the cache,
+  //! so on a cache hit the pieceCount[color] and pieceCount[color|Pawn]
+  //! entries are set and all other pieceCount entries are zero.
+  //! \param eval Receives the cached StaticEval() result
+  //! \return false if the position is not in the eval cache
+  //--------------------------------------------------------------------------
+  inline bool ProbeEvalCache(int& eval) {
+    int counts;
+    if (!td->ctx->evalCache.IsEnabled()) {
+      return false;
+    }
+    td->stats.evalLookups++;
+    if (!td->ctx->evalCache.Probe(positionKey, eval, counts)) {
+      return false;
+    }
+    td->stats.evalHits++;
+    memset(pieceCount, 0, sizeof(pieceCount));
+    pieceCount[White]        = static_cast<char>(counts & 0xF);
+    pieceCount[Black]        = static_cast<char>((counts >> 4) & 0xF);
+    pieceCount[White|Pawn]   = static_cast<char>((counts >> 8) & 0xF);
+    pieceCount[Black|Pawn]   = static_cast<char>((counts >> 12) & 0xF);
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Put StaticEval() result for the position at this node in the eval cache
+  //--------------------------------------------------------------------------
+  inline void StoreEvalCache(const int eval) {
+    if (td->ctx->evalCache.IsEnabled()) {
+      assert(pieceCount[White] < 16);
+      assert(pieceCount[Black] < 16);
+      assert(pieceCount[White|Pawn] < 16);
+      assert(pieceCount[Black|Pawn] < 16);
+      td->ctx->evalCache.Store(positionKey, eval,
+                       (pieceCount[White] |
+                        (pieceCount[Black] << 4) |
+                        (pieceCount[White|Pawn] << 8) |
+                        (pieceCount[Black|Pawn] << 12)));
+    }
+  }
+
   //--------------------------------------------------------------------------
   //! \brief Get static evaluation of the position at this node
   //! Most commonly used search techniques are practically required for any
@@ -2047,126 +2820,156 @@ private:
   //! calculations such as piece mobility and threat detection feasible,
   //! very minimal evaluation techniques are used in Clubfoot.
   //--------------------------------------------------------------------------
-  inline void Evaluate() {
+  inline void Evaluate() {
+    int eval;
+    if (!ProbeEvalCache(eval)) {
+      eval = StaticEval();
+      StoreEvalCache(eval);
+    }
+
+    // NOTE: if draw due to rcount this destabilizes the transposition table
+    //       because rcount is not encoded into positionKey
+    if (IsDraw() || (eval == NoMatingMaterial)) {
+      state |= Draw;
+      standPat = td->drawScore[ColorToMove()];
+      return;
+    }
+
+    // reduce winning score if rcount is getting large
+    // NOTE: this destabilizes transposition table values
+    //       because rcount is not encoded into positionKey
+    if ((rcount > 25) && (abs(eval) > 8)) {
+      eval = static_cast<int>(eval * (25.0 / rcount));
+    }
+
+    // standPat is eval from persepctive of the side to move
+    standPat = (ColorToMove() ? -eval : eval);
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Estimate the evaluation of the position at this node
+  //! Material, piece-square and material table terms are all kept up to date
+  //! by Exec(), so they are nearly free.  If they put the position more than
+  //! the lazy margin outside of [alpha, beta] the remaining terms (pawns,
+  //! kings and piece placement) are assumed unable to bring it back, and standPat
+  //! is set to the bound of the estimate that is nearest the window.
+  //! Positions the material table scales or flags as unwinnable, or that
+  //! are scaled down by rcount in Evaluate(), are never estimated.
+  //! \return true if standPat was set from the estimate
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline bool LazyEval(const int alpha, const int beta) {
+    if (!td->ctx->lazyMargin || (rcount > 25)) {
+      return false;
+    }
+
+    const MaterialInfo* info = _material.Probe(materialKey);
+    if (!info || (info->scale != MaterialInfo::NoScale) ||
+        (info->flags != (MaterialInfo::WhiteCanWin |
+                         MaterialInfo::BlackCanWin)))
+    {
+      return false;
+    }
+
+    int eval = (material[White] - material[Black] +
+                pst[White] - pst[Black] + info->score +
+                (color ? -td->ctx->tempo : td->ctx->tempo));
+    if (color) {
+      eval = -eval;
+    }
+    if ((eval - td->ctx->lazyMargin) >= beta) {
+      standPat = (eval - td->ctx->lazyMargin);
+      return true;
+    }
+    if ((eval + td->ctx->lazyMargin) <= alpha) {
+      standPat = (eval + td->ctx->lazyMargin);
+      return true;
+    }
+    return false;
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Get static evaluation of the position at this node
+  //! The result depends only on the position key, so it can be cached.
+  //! \return Evaluation from white's perspective, not counting rcount,
+  //!         or NoMatingMaterial if neither side can win
+  //--------------------------------------------------------------------------
+  inline int StaticEval() {
     int pieceStack[32];
     int stackCount = 0;
     int pc;
     int eval = (material[White] - material[Black] +
-                (ColorToMove() ? -_tempo : _tempo));
+                pst[White] - pst[Black] +
+                (ColorToMove() ? -td->ctx->tempo : td->ctx->tempo));
 
     memset(pieceCount, 0, sizeof(pieceCount));
-    memset(passers, 0, sizeof(passers));
-    memset(openFile, 1, sizeof(openFile));
 
-    // evaluate pawns first to populate openFile map
-    for (senjo::Square sqr = senjo::Square::A1; sqr.IsValid(); ++sqr) {
-      switch ((pc = _board[sqr.Name()])) {
-      case (White|Pawn): eval += PawnEval<White>(sqr); break;
-      case (Black|Pawn): eval -= PawnEval<Black>(sqr); break;
-      case (White|Knight):
-      case (Black|Knight):
-      case (White|Bishop):
-      case (Black|Bishop):
-      case (White|Rook):
-      case (Black|Rook):
-      case (White|Queen):
-      case (Black|Queen):
-        pieceCount[COLOR_OF(pc)]++;
-        pieceStack[stackCount++] = sqr.Name();
-        break;
-      case (White|King):
-      case (Black|King):
-        assert(king[COLOR_OF(pc)] == sqr.Name());
-        pieceStack[stackCount++] = sqr.Name();
-        continue;
-      default:
-        assert(pc == 0);
-        continue;
+    for (int color = White; color <= Black; ++color) {
+      const char* pieces = td->pieceList[color];
+#ifndef NDEBUG
+      int check = 0;
+      for (int i = 0; i < td->listSize[color]; ++i) {
+        check += PstValue(board[pieces[i]], pieces[i]);
+      }
+      assert(check == pst[color]);
+#endif
+      for (int i = 0; i < td->listSize[color]; ++i) {
+        const int sqr = pieces[i];
+        switch ((pc = board[sqr])) {
+        case (White|Pawn):
+        case (Black|Pawn):
+          break;
+        case (White|Knight):
+        case (Black|Knight):
+        case (White|Bishop):
+        case (Black|Bishop):
+        case (White|Rook):
+        case (Black|Rook):
+        case (White|Queen):
+        case (Black|Queen):
+          pieceCount[COLOR_OF(pc)]++;
+          pieceStack[stackCount++] = sqr;
+          break;
+        case (White|King):
+        case (Black|King):
+          assert(king[COLOR_OF(pc)] == sqr);
+          pieceStack[stackCount++] = sqr;
+          continue;
+        default:
+          assert(false);
+          continue;
+        }
+        assert(COLOR_OF(pc) == color);
+        pieceCount[pc]++;
       }
-      pieceCount[pc]++;
     }
 
-    // NOTE: if draw due to rcount this destabilizes the transposition table
-    //       because rcount is not encoded into positionKey
-    if (IsDraw()) {
-      state |= Draw;
-      standPat = _drawScore[ColorToMove()];
-      return;
+    // material terms from piece counts
+    MaterialInfo overflow;
+    const MaterialInfo* info = _material.Probe(materialKey);
+    assert((MaterialTable::GetKey(pieceCount) | MaterialTable::Overflow) ==
+           (materialKey | MaterialTable::Overflow));
+    if (!info) {
+      overflow.Init(pieceCount);
+      info = &overflow;
     }
 
-    bool whiteCanWin = (pieceCount[White|Pawn] ||
-                       (pieceCount[White|Knight] > 2) ||
-                       (pieceCount[White|Bishop] > 1) ||
-                       (pieceCount[White|Knight] && pieceCount[White|Bishop]) ||
-                        pieceCount[White|Rook] ||
-                        pieceCount[White|Queen]);
-
-    bool blackCanWin = (pieceCount[Black|Pawn] ||
-                       (pieceCount[Black|Knight] > 2) ||
-                       (pieceCount[Black|Bishop] > 1) ||
-                       (pieceCount[Black|Knight] && pieceCount[Black|Bishop]) ||
-                        pieceCount[Black|Rook] ||
-                        pieceCount[Black|Queen]);
-
     // draw due to insufficient mating material?
+    const bool whiteCanWin = (info->flags & MaterialInfo::WhiteCanWin);
+    const bool blackCanWin = (info->flags & MaterialInfo::BlackCanWin);
     if (!whiteCanWin && !blackCanWin) {
-      state |= Draw;
-      standPat = _drawScore[ColorToMove()];
-      return;
-    }
-
-    // redundant knights are worth slightly less
-    if (pieceCount[White|Knight] > 1) {
-      eval -= (16 * (pieceCount[White|Knight] - 1));
-    }
-    if (pieceCount[Black|Knight] > 1) {
-      eval += (16 * (pieceCount[Black|Knight] - 1));
-    }
-
-    // no pawns is bad
-    if (!pieceCount[White|Pawn]) {
-      eval -= 50;
+      return NoMatingMaterial;
     }
-    if (!pieceCount[Black|Pawn]) {
-      eval += 50;
-    }
-
-    // are there any pawns on the board?
-    if ((pc = (pieceCount[White|Pawn] + pieceCount[Black|Pawn]))) {
-      // increase value of 1 knight relative to # of pawns on the board
-      pc = ((4 * pc) / 3); // inflate pawn count a little bit
-      assert(pc <= 21);
-      if (pieceCount[White|Knight]) {
-        eval += pc;
-      }
-      if (pieceCount[Black|Knight]) {
-        eval -= pc;
-      }
 
-      // increase value of 1 rook as pawns come off the board
-      pc = ((4 * pc) / 3); // inflate pawn count a bit more
-      assert(pc <= 28);
-      if (pieceCount[White|Rook]) {
-        eval += (28 - pc);
-      }
-      if (pieceCount[Black|Rook]) {
-        eval -= (28 - pc);
-      }
+    eval += info->score;
 
-      // bishop pair more valuable as pawns come off the board
-      // NOTE: this doesn't verify the bishops are on opposite color squares!
-      if (pieceCount[White|Bishop] >= 2) {
-        eval += (48 - pc);
-      }
-      if (pieceCount[Black|Bishop] >= 2) {
-        eval -= (48 - pc);
-      }
-    }
+    // evaluate pawns first to populate openFile map
+    eval += PawnStructure();
 
     // evaluate pieces
     for (int i = 0; i < stackCount; ++i) {
       const senjo::Square sqr(pieceStack[i]);
-      switch (_board[sqr.Name()]) {
+      switch (board[sqr.Name()]) {
       case (White|Knight): eval += KnightEval<White>(sqr); break;
       case (Black|Knight): eval -= KnightEval<Black>(sqr); break;
       case (White|Bishop): eval += BishopEval<White>(sqr); break;
@@ -2189,50 +2992,29 @@ private:
       eval = ((eval * abs(eval)) / 1000);
       eval += (whiteCanWin ? 50 : -50);
     }
-
-    else if (!pieceCount[White|Pawn] && !pieceCount[Black|Pawn]) {
-      // reduce winning score if Q vs R
-      if ((pieceCount[White] == 1) && (pieceCount[Black] == 1) &&
-          ((pieceCount[White|Queen] && pieceCount[Black|Rook]) ||
-           (pieceCount[Black|Queen] && pieceCount[White|Rook])))
-      {
+    else {
+      switch (info->scale) {
+      case MaterialInfo::QueenVsRook:
         eval -= ((eval > 0) ? 80 : -80);
+        break;
+      case MaterialInfo::RookVsMinors:
+        if (abs(eval) < 256) {
+          eval = ((eval * abs(eval)) / 256);
+        }
+        break;
+      case MaterialInfo::RookVsRook:
+        if (abs(eval) < 128) {
+          eval = ((eval * abs(eval)) / 128);
+        }
+        break;
+      default:
+        break;
       }
-
-      // reduce winning score if R vs minor(s)
-      else if ((pieceCount[White] == 1) && (pieceCount[White|Rook] == 1) &&
-               (pieceCount[Black] <= 2) &&
-               !pieceCount[Black|Rook] && !pieceCount[Black|Queen] &&
-               (abs(eval) < 256))
-      {
-        eval = ((eval * abs(eval)) / 256);
-      }
-      else if ((pieceCount[Black] == 1) && (pieceCount[Black|Rook] == 1) &&
-               (pieceCount[White] <= 2) &&
-               !pieceCount[White|Rook] && !pieceCount[White|Queen] &&
-               (abs(eval) < 256))
-      {
-        eval = ((eval * abs(eval)) / 256);
-      }
-    }
-
-    // reduce winning score if pawns + R vs R ending
-    else if ((pieceCount[White] == 1) && pieceCount[White|Rook] &&
-             (pieceCount[Black] == 1) && pieceCount[Black|Rook] &&
-             (abs(eval) < 128))
-    {
-      eval = ((eval * abs(eval)) / 128);
     }
 
-    // reduce winning score if rcount is getting large
-    // NOTE: this destabilizes transposition table values
-    //       because rcount is not encoded into positionKey
-    if ((rcount > 25) && (abs(eval) > 8)) {
-      eval = static_cast<int>(eval * (25.0 / rcount));
-    }
-
-    // standPat is eval from persepctive of the side to move
-    standPat = (ColorToMove() ? -eval : eval);
+    assert(eval > NoMatingMaterial);
+    assert(eval < -NoMatingMaterial);
+    return eval;
   }
 
   //--------------------------------------------------------------------------
@@ -2245,22 +3027,29 @@ private:
     assert(!AttackedBy<!color>(king[color]));
     assert(&dest != this);
 
-    _stats.nullMoves++;
+    td->stats.nullMoves++;
+    td->keys[ThreadData::GameKeys + ply] = 0; // not a repeatable position
 
     dest.lastMove.Clear();
     dest.king[White] = king[White];
     dest.king[Black] = king[Black];
     dest.material[White] = material[White];
     dest.material[Black] = material[Black];
+    dest.pst[White] = pst[White];
+    dest.pst[Black] = pst[Black];
     dest.mcount = mcount;
     dest.rcount = rcount;
     dest.state = (state ^ ColorMask);
     dest.ep = senjo::Square::None;
-    dest.checkState = CheckState::Unknown;
+    dest.checkState = NotInCheck; // we're not in check, so neither are they
+    dest.lazyEval = false;
     dest.pieceKey = pieceKey;
+    dest.pawnKey = pawnKey;
+    dest.materialKey = materialKey;
     dest.positionKey = (pieceKey ^
                         _HASH[0][dest.state & FiveBits] ^
                         _HASH[0][senjo::Square::None]);
+    td->tt->Prefetch(dest.positionKey);
     dest.Evaluate();
   }
 
@@ -2287,8 +3076,8 @@ private:
 
     const int from  = move.GetFromName();
     const int to    = move.GetToName();
-    const int pc    = _board[from];
-    const int cap   = _board[to];
+    const int pc    = board[from];
+    const int cap   = board[to];
     const int promo = move.GetPromo();
 
     VASSERT(pc);
@@ -2394,9 +3183,9 @@ private:
       VASSERT(!promo);
       VASSERT(from == (color ? senjo::Square::E8 : senjo::Square::E1));
       VASSERT(  to == (color ? senjo::Square::G8 : senjo::Square::G1));
-      VASSERT(!_board [color ? senjo::Square::F8 : senjo::Square::F1]);
-      VASSERT(!_board [color ? senjo::Square::G8 : senjo::Square::G1]);
-      VASSERT( _board [color ? senjo::Square::H8 : senjo::Square::H1] == (color|Rook));
+      VASSERT(!board [color ? senjo::Square::F8 : senjo::Square::F1]);
+      VASSERT(!board [color ? senjo::Square::G8 : senjo::Square::G1]);
+      VASSERT( board [color ? senjo::Square::H8 : senjo::Square::H1] == (color|Rook));
       VASSERT(!AttackedBy<!color>(move.GetFrom()));
       VASSERT(!AttackedBy<!color>(move.GetFrom() + senjo::East));
       VASSERT(!AttackedBy<!color>(move.GetTo()));
@@ -2408,10 +3197,10 @@ private:
       VASSERT(!promo);
       VASSERT(from == (color ? senjo::Square::E8 : senjo::Square::E1));
       VASSERT(  to == (color ? senjo::Square::C8 : senjo::Square::C1));
-      VASSERT( _board [color ? senjo::Square::A8 : senjo::Square::A1] == (color|Rook));
-      VASSERT(!_board [color ? senjo::Square::B8 : senjo::Square::B1]);
-      VASSERT(!_board [color ? senjo::Square::C8 : senjo::Square::C1]);
-      VASSERT(!_board [color ? senjo::Square::D8 : senjo::Square::D1]);
+      VASSERT( board [color ? senjo::Square::A8 : senjo::Square::A1] == (color|Rook));
+      VASSERT(!board [color ? senjo::Square::B8 : senjo::Square::B1]);
+      VASSERT(!board [color ? senjo::Square::C8 : senjo::Square::C1]);
+      VASSERT(!board [color ? senjo::Square::D8 : senjo::Square::D1]);
       VASSERT(!AttackedBy<!color>(move.GetFrom()));
       VASSERT(!AttackedBy<!color>(move.GetFrom() + senjo::West));
       VASSERT(!AttackedBy<!color>(move.GetTo()));
@@ -2423,17 +3212,248 @@ private:
     return 0;
   }
 
+  //--------------------------------------------------------------------------
+  //! Expand a compact move to a full move for the position at this node
+  //! \param compact The 16 bit compact form of the move
+  //! \param score The score to assign to the expanded move
+  //! \param move Receives the expanded move
+  //! \return false if the move is not legal at this node
+  //--------------------------------------------------------------------------
+  template<Color color>
+  bool ExpandMove(const int compact, const int score, Move& move) {
+    const senjo::Square from(Move::CompactFrom(compact));
+    const senjo::Square to(Move::CompactTo(compact));
+    const senjo::Direction dir = from.DirectionTo(to);
+    const int fwd = (color ? senjo::South : senjo::North);
+    const int pc = board[from.Name()];
+    int cap = board[to.Name()];
+    int promo = 0;
+    Move::MoveType type = Move::Normal;
+
+    if (!pc || (COLOR_OF(pc) != color) ||
+        (cap && ((COLOR_OF(cap) == color) || (cap == ((!color)|King)))))
+    {
+      return false;
+    }
+
+    switch (pc) {
+    case (color|Pawn):
+      if ((to.Name() - from.Name()) == fwd) {
+        if (cap) {
+          return false;
+        }
+        type = Move::PawnPush;
+      }
+      else if ((to.Name() - from.Name()) == (2 * fwd)) {
+        if (cap || (from.Y() != (color ? 6 : 1)) || board[from.Name() + fwd])
+        {
+          return false;
+        }
+        type = Move::PawnLung;
+      }
+      else if (((to.Name() - from.Name()) == (fwd - 1)) ||
+               ((to.Name() - from.Name()) == (fwd + 1)))
+      {
+        if (cap) {
+          type = Move::PawnCapture;
+        }
+        else if (ep.IsValid() && (to == ep)) {
+          type = Move::EnPassant;
+          cap = ((!color)|Pawn);
+        }
+        else {
+          return false;
+        }
+      }
+      else {
+        return false;
+      }
+      if (to.Y() == (color ? 0 : 7)) {
+        promo = (color|Move::CompactPromo(compact));
+      }
+      break;
+    case (color|Knight):
+      switch (dir) {
+      case senjo::KnightMove1: case senjo::KnightMove2:
+      case senjo::KnightMove3: case senjo::KnightMove4:
+      case senjo::KnightMove5: case senjo::KnightMove6:
+      case senjo::KnightMove7: case senjo::KnightMove8:
+        break;
+      default:
+        return false;
+      }
+      break;
+    case (color|Bishop):
+    case (color|Rook):
+    case (color|Queen):
+      switch (dir) {
+      case senjo::SouthWest: case senjo::SouthEast:
+      case senjo::NorthWest: case senjo::NorthEast:
+        if (pc == (color|Rook)) {
+          return false;
+        }
+        break;
+      case senjo::South: case senjo::West:
+      case senjo::East:  case senjo::North:
+        if (pc == (color|Bishop)) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+      }
+      for (senjo::Square sqr = (from + dir); sqr != to; sqr += dir) {
+        if (board[sqr.Name()]) {
+          return false;
+        }
+      }
+      break;
+    case (color|King):
+      if (from.DistanceTo(to) == 1) {
+        type = Move::KingMove;
+      }
+      else if ((from == (color ? senjo::Square::E8 : senjo::Square::E1)) &&
+               (to == (color ? senjo::Square::G8 : senjo::Square::G1)))
+      {
+        if (!(state & (color ? BlackShort : WhiteShort)) ||
+            board[color ? senjo::Square::F8 : senjo::Square::F1] ||
+            board[color ? senjo::Square::G8 : senjo::Square::G1] ||
+            AttackedBy<!color>(color ? senjo::Square::E8 : senjo::Square::E1) ||
+            AttackedBy<!color>(color ? senjo::Square::F8 : senjo::Square::F1) ||
+            AttackedBy<!color>(color ? senjo::Square::G8 : senjo::Square::G1))
+        {
+          return false;
+        }
+        move.Init(Move::CastleShort, from.Name(), to.Name(), pc, 0, 0, score);
+        if (SpecialMoveGivesCheck<color>(from.Name(), to.Name(),
+                                         Move::CastleShort))
+        {
+          move.SetGivesCheck();
+        }
+        return true;
+      }
+      else if ((from == (color ? senjo::Square::E8 : senjo::Square::E1)) &&
+               (to == (color ? senjo::Square::C8 : senjo::Square::C1)))
+      {
+        if (!(state & (color ? BlackLong : WhiteLong)) ||
+            board[color ? senjo::Square::B8 : senjo::Square::B1] ||
+            board[color ? senjo::Square::C8 : senjo::Square::C1] ||
+            board[color ? senjo::Square::D8 : senjo::Square::D1] ||
+            AttackedBy<!color>(color ? senjo::Square::C8 : senjo::Square::C1) ||
+            AttackedBy<!color>(color ? senjo::Square::D8 : senjo::Square::D1) ||
+            AttackedBy<!color>(color ? senjo::Square::E8 : senjo::Square::E1))
+        {
+          return false;
+        }
+        move.Init(Move::CastleLong, from.Name(), to.Name(), pc, 0, 0, score);
+        if (SpecialMoveGivesCheck<color>(from.Name(), to.Name(),
+                                         Move::CastleLong))
+        {
+          move.SetGivesCheck();
+        }
+        return true;
+      }
+      else {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+
+    // make sure the move doesn't leave our king in check
+    const int capSqr = (type == Move::EnPassant) ? (to.Name() - fwd)
+                                                 : to.Name();
+    const int captured = board[capSqr];
+    board[capSqr] = 0;
+    board[to.Name()] = pc;
+    board[from.Name()] = 0;
+    const bool illegal = AttackedBy<!color>(
+        senjo::Square((pc == (color|King)) ? to.Name() : king[color]));
+    board[from.Name()] = pc;
+    board[to.Name()] = 0;
+    board[capSqr] = captured;
+    if (illegal) {
+      return false;
+    }
+
+    move.Init(type, from.Name(), to.Name(), pc, cap, promo, score);
+    if (GivesCheck<color, false>(from.Name(), to.Name(), type, pc, promo)) {
+      move.SetGivesCheck();
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Store the best move for the position at this node in the transposition
+  //! table, see TranspositionTable::Store()
+  //! Table activity is counted in this thread's stats rather than in the
+  //! table, which may be written by every search thread at once.
+  //--------------------------------------------------------------------------
+  inline void StoreHash(const Move& bestmove, const int depth,
+                        const int primaryFlag, const int otherFlags)
+  {
+    if (td->tt->Store(positionKey, bestmove, depth, primaryFlag, otherFlags)) {
+      td->stats.hashStores++;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Store the position at this node as checkmate
+  //--------------------------------------------------------------------------
+  inline void StoreCheckmate() {
+    td->tt->StoreCheckmate(positionKey);
+    td->stats.checkmates++;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Store the position at this node as stalemate
+  //--------------------------------------------------------------------------
+  inline void StoreStalemate() {
+    td->tt->StoreStalemate(positionKey);
+    td->stats.stalemates++;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the transposition table entry for the position at this node
+  //! \param entry Receives a copy of the entry
+  //! \param move Receives the entry's best move (if any)
+  //! \return false if no usable entry exists for the position at this node
+  //--------------------------------------------------------------------------
+  template<Color color>
+  inline bool ProbeHash(HashEntry& entry, Move& move) {
+    if (!td->tt->Probe(positionKey, entry)) {
+      return false;
+    }
+    td->stats.hashHits++;
+    switch (entry.GetPrimaryFlag()) {
+    case HashEntry::Checkmate:
+    case HashEntry::Stalemate:
+      return true;
+    default:
+      if (!entry.move) {
+        move.Clear();
+        return true;
+      }
+      // entries only verify 32 bits of positionKey, the move must be legal
+      return ExpandMove<color>(entry.move, entry.score, move);
+    }
+  }
+
   //--------------------------------------------------------------------------
   //! Execute the given move against the position at this node,
   //! the resulting position is applied to the given 'dest' node.
+  //! \param lazy If true don't evaluate 'dest', QSearch() will do it
   //--------------------------------------------------------------------------
   template<Color color>
-  inline void Exec(const Move& move, ClubFoot& dest) const {
+  inline void Exec(const Move& move, ClubFoot& dest, const bool lazy = false)
+    const
+  {
     assert(ColorToMove() == color);
     assert(ValidateMove<color>(move) == 0);
 
-    _stats.execs++;
-    _seen.insert(positionKey);
+    td->stats.execs++;
+    td->keys[ThreadData::GameKeys + ply] = positionKey;
     dest.lastMove = move;
 
     switch (move.GetType()) {
@@ -2441,12 +3461,21 @@ private:
       senjo::Output() << "Cannot execute invalid move";
       return;
     case Move::Normal:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      if (move.GetCap()) {
+        RemovePiece(!color, move.GetToName());
+      }
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[White] = king[White];
       dest.king[Black] = king[Black];
       dest.material[color] = material[color];
       dest.material[!color] = (material[!color] - ValueOf(move.GetCap()));
+      dest.pst[color] = (pst[color] -
+          _PIECE_SQR[move.GetPc()][move.GetFromName()] +
+          _PIECE_SQR[move.GetPc()][move.GetToName()]);
+      dest.pst[!color] = (pst[!color] -
+          PstValue(move.GetCap(), move.GetToName()));
       dest.mcount = (mcount + 1);
       dest.rcount = (move.GetCap() ? 0 : (rcount + 1));
       dest.state = ((state ^ ColorMask) &
@@ -2457,11 +3486,16 @@ private:
           _HASH[move.GetPc()][move.GetFromName()] ^
           _HASH[move.GetPc()][move.GetToName()] ^
           (move.GetCap() ? _HASH[move.GetCap()][move.GetToName()] : 0));
+      dest.pawnKey = (pawnKey ^ ((move.GetCap() == ((!color)|Pawn))
+          ? _HASH[(!color)|Pawn][move.GetToName()] : 0));
+      dest.materialKey = (materialKey -
+          MaterialTable::WeightOf(move.GetCap()));
       break;
     case Move::PawnPush:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPromo() ? move.GetPromo()
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPromo() ? move.GetPromo()
                                                  : move.GetPc();
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[White] = king[White];
       dest.king[Black] = king[Black];
       if (move.GetPromo()) {
@@ -2472,6 +3506,9 @@ private:
         dest.material[color] = material[color];
       }
       dest.material[!color] = material[!color];
+      dest.pst[color] = (pst[color] +
+          PstValue(move.GetPromo(), move.GetToName()));
+      dest.pst[!color] = pst[!color];
       dest.mcount = (mcount + 1);
       dest.rcount = 0;
       dest.state = (state ^ ColorMask);
@@ -2480,20 +3517,30 @@ private:
         dest.pieceKey = (pieceKey ^
             _HASH[color|Pawn][move.GetFromName()] ^
             _HASH[move.GetPromo()][move.GetToName()]);
+        dest.pawnKey = (pawnKey ^ _HASH[color|Pawn][move.GetFromName()]);
       }
       else {
         dest.pieceKey = (pieceKey ^
             _HASH[color|Pawn][move.GetFromName()] ^
             _HASH[color|Pawn][move.GetToName()]);
+        dest.pawnKey = (pawnKey ^
+            _HASH[color|Pawn][move.GetFromName()] ^
+            _HASH[color|Pawn][move.GetToName()]);
       }
+      dest.materialKey = (move.GetPromo()
+          ? MaterialTable::Promote(materialKey, move.GetPromo())
+          : materialKey);
       break;
     case Move::PawnLung:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[White] = king[White];
       dest.king[Black] = king[Black];
       dest.material[White] = material[White];
       dest.material[Black] = material[Black];
+      dest.pst[White] = pst[White];
+      dest.pst[Black] = pst[Black];
       dest.mcount = (mcount + 1);
       dest.rcount = 0;
       dest.state = (state ^ ColorMask);
@@ -2501,11 +3548,17 @@ private:
       dest.pieceKey = (pieceKey ^
           _HASH[color|Pawn][move.GetFromName()] ^
           _HASH[color|Pawn][move.GetToName()]);
+      dest.pawnKey = (pawnKey ^
+          _HASH[color|Pawn][move.GetFromName()] ^
+          _HASH[color|Pawn][move.GetToName()]);
+      dest.materialKey = materialKey;
       break;
     case Move::PawnCapture:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPromo() ? move.GetPromo()
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPromo() ? move.GetPromo()
                                                  : move.GetPc();
+      RemovePiece(!color, move.GetToName());
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[White] = king[White];
       dest.king[Black] = king[Black];
       if (move.GetPromo()) {
@@ -2516,6 +3569,10 @@ private:
         dest.material[color] = material[color];
       }
       dest.material[!color] = (material[!color] - ValueOf(move.GetCap()));
+      dest.pst[color] = (pst[color] +
+          PstValue(move.GetPromo(), move.GetToName()));
+      dest.pst[!color] = (pst[!color] -
+          PstValue(move.GetCap(), move.GetToName()));
       dest.mcount = (mcount + 1);
       dest.rcount = 0;
       dest.state = ((state ^ ColorMask) & ~Touch(move.GetToName()));
@@ -2525,22 +3582,37 @@ private:
             _HASH[color|Pawn][move.GetFromName()] ^
             _HASH[move.GetPromo()][move.GetToName()] ^
             _HASH[move.GetCap()][move.GetToName()]);
+        dest.pawnKey = (pawnKey ^ _HASH[color|Pawn][move.GetFromName()]);
       }
       else {
         dest.pieceKey = (pieceKey ^
             _HASH[color|Pawn][move.GetFromName()] ^
             _HASH[color|Pawn][move.GetToName()] ^
             _HASH[move.GetCap()][move.GetToName()]);
+        dest.pawnKey = (pawnKey ^
+            _HASH[color|Pawn][move.GetFromName()] ^
+            _HASH[color|Pawn][move.GetToName()]);
+      }
+      if (move.GetCap() == ((!color)|Pawn)) {
+        dest.pawnKey ^= _HASH[(!color)|Pawn][move.GetToName()];
       }
+      dest.materialKey = ((move.GetPromo()
+          ? MaterialTable::Promote(materialKey, move.GetPromo())
+          : materialKey) - MaterialTable::WeightOf(move.GetCap()));
       break;
     case Move::EnPassant:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
-      _board[move.GetToName() + (color ? senjo::North : senjo::South)] = 0;
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      board[move.GetToName() + (color ? senjo::North : senjo::South)] = 0;
+      RemovePiece(!color, (move.GetToName() +
+                           (color ? senjo::North : senjo::South)));
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[White] = king[White];
       dest.king[Black] = king[Black];
       dest.material[color] = material[color];
       dest.material[!color] = (material[!color] - PawnValue);
+      dest.pst[White] = pst[White];
+      dest.pst[Black] = pst[Black];
       dest.mcount = (mcount + 1);
       dest.rcount = 0;
       dest.state = (state ^ ColorMask);
@@ -2550,14 +3622,28 @@ private:
           _HASH[color|Pawn][move.GetToName()] ^
           _HASH[(!color)|Pawn][move.GetToName() +
                 (color ? senjo::North : senjo::South)]);
+      dest.pawnKey = (pawnKey ^
+          _HASH[color|Pawn][move.GetFromName()] ^
+          _HASH[color|Pawn][move.GetToName()] ^
+          _HASH[(!color)|Pawn][move.GetToName() +
+                (color ? senjo::North : senjo::South)]);
+      dest.materialKey = (materialKey -
+          MaterialTable::WeightOf((!color)|Pawn));
       break;
     case Move::KingMove:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      if (move.GetCap()) {
+        RemovePiece(!color, move.GetToName());
+      }
+      MovePiece(color, move.GetFromName(), move.GetToName());
       dest.king[color] = move.GetToName();
       dest.king[!color] = king[!color];
       dest.material[color] = material[color];
       dest.material[!color] = (material[!color] - ValueOf(move.GetCap()));
+      dest.pst[color] = pst[color];
+      dest.pst[!color] = (pst[!color] -
+          PstValue(move.GetCap(), move.GetToName()));
       dest.mcount = (mcount + 1);
       dest.rcount = (move.GetCap() ? 0 : (rcount + 1));
       dest.state = ((state ^ ColorMask) & ~Touch(move.GetToName()) &
@@ -2567,16 +3653,27 @@ private:
           _HASH[color|King][move.GetFromName()] ^
           _HASH[color|King][move.GetToName()] ^
           (move.GetCap() ? _HASH[move.GetCap()][move.GetToName()] : 0));
+      dest.pawnKey = (pawnKey ^ ((move.GetCap() == ((!color)|Pawn))
+          ? _HASH[(!color)|Pawn][move.GetToName()] : 0));
+      dest.materialKey = (materialKey -
+          MaterialTable::WeightOf(move.GetCap()));
       break;
     case Move::CastleShort:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
-      _board[color ? senjo::Square::H8 : senjo::Square::H1] = 0;
-      _board[color ? senjo::Square::F8 : senjo::Square::F1] = (color|Rook);
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      board[color ? senjo::Square::H8 : senjo::Square::H1] = 0;
+      board[color ? senjo::Square::F8 : senjo::Square::F1] = (color|Rook);
+      MovePiece(color, move.GetFromName(), move.GetToName());
+      MovePiece(color, (color ? senjo::Square::H8 : senjo::Square::H1),
+                (color ? senjo::Square::F8 : senjo::Square::F1));
       dest.king[color] = move.GetToName();
       dest.king[!color] = king[!color];
       dest.material[White] = material[White];
       dest.material[Black] = material[Black];
+      dest.pst[color] = (pst[color] -
+        _PIECE_SQR[color|Rook][color ? senjo::Square::H8 : senjo::Square::H1] +
+        _PIECE_SQR[color|Rook][color ? senjo::Square::F8 : senjo::Square::F1]);
+      dest.pst[!color] = pst[!color];
       dest.mcount = (mcount + 1);
       dest.rcount = (rcount + 1);
       dest.state = ((state ^ ColorMask) &
@@ -2587,16 +3684,25 @@ private:
           _HASH[color|King][move.GetToName()] ^
           _HASH[color|Rook][color ? senjo::Square::F8 : senjo::Square::F1] ^
           _HASH[color|Rook][color ? senjo::Square::H8 : senjo::Square::H1]);
+      dest.pawnKey = pawnKey;
+      dest.materialKey = materialKey;
       break;
     case Move::CastleLong:
-      _board[move.GetFromName()] = 0;
-      _board[move.GetToName()] = move.GetPc();
-      _board[color ? senjo::Square::A8 : senjo::Square::A1] = 0;
-      _board[color ? senjo::Square::D8 : senjo::Square::D1] = (color|Rook);
+      board[move.GetFromName()] = 0;
+      board[move.GetToName()] = move.GetPc();
+      board[color ? senjo::Square::A8 : senjo::Square::A1] = 0;
+      board[color ? senjo::Square::D8 : senjo::Square::D1] = (color|Rook);
+      MovePiece(color, move.GetFromName(), move.GetToName());
+      MovePiece(color, (color ? senjo::Square::A8 : senjo::Square::A1),
+                (color ? senjo::Square::D8 : senjo::Square::D1));
       dest.king[color] = move.GetToName();
       dest.king[!color] = king[!color];
       dest.material[White] = material[White];
       dest.material[Black] = material[Black];
+      dest.pst[color] = (pst[color] -
+        _PIECE_SQR[color|Rook][color ? senjo::Square::A8 : senjo::Square::A1] +
+        _PIECE_SQR[color|Rook][color ? senjo::Square::D8 : senjo::Square::D1]);
+      dest.pst[!color] = pst[!color];
       dest.mcount = (mcount + 1);
       dest.rcount = (rcount + 1);
       dest.state = ((state ^ ColorMask) &
@@ -2607,13 +3713,21 @@ private:
           _HASH[color|King][move.GetToName()] ^
           _HASH[color|Rook][color ? senjo::Square::A8 : senjo::Square::A1] ^
           _HASH[color|Rook][color ? senjo::Square::D8 : senjo::Square::D1]);
+      dest.pawnKey = pawnKey;
+      dest.materialKey = materialKey;
       break;
     }
-    dest.checkState = CheckState::Unknown;
+    dest.checkState = (move.GivesCheck() ? IsInCheck : NotInCheck);
+    assert(dest.checkState == (AttackedBy<color>(dest.king[!color])
+                               ? IsInCheck : NotInCheck));
     dest.positionKey = (dest.pieceKey ^
                         _HASH[0][dest.state & FiveBits] ^
                         _HASH[0][dest.ep.Name()]);
-    dest.Evaluate();
+    td->tt->Prefetch(dest.positionKey);
+    dest.lazyEval = lazy;
+    if (!lazy) {
+      dest.Evaluate();
+    }
   }
 
   //--------------------------------------------------------------------------
@@ -2627,70 +3741,104 @@ private:
       senjo::Output() << "Cannot undo invalid move";
       return;
     case Move::Normal:
-      _board[move.GetToName()] = move.GetCap();
+    case Move::PawnCapture:
+    case Move::KingMove:
+      board[move.GetToName()] = move.GetCap();
+      MovePiece(color, move.GetToName(), move.GetFromName());
+      if (move.GetCap()) {
+        AddPiece(!color, move.GetToName());
+      }
       break;
     case Move::PawnPush:
     case Move::PawnLung:
-      _board[move.GetToName()] = 0;
-      break;
-    case Move::PawnCapture:
-      _board[move.GetToName()] = move.GetCap();
+      board[move.GetToName()] = 0;
+      MovePiece(color, move.GetToName(), move.GetFromName());
       break;
     case Move::EnPassant:
-      _board[move.GetToName()] = 0;
-      _board[move.GetToName() + (color ? senjo::North : senjo::South)] = move.GetCap();
-      break;
-    case Move::KingMove:
-      _board[move.GetToName()] = move.GetCap();
+      board[move.GetToName()] = 0;
+      board[move.GetToName() + (color ? senjo::North : senjo::South)] = move.GetCap();
+      MovePiece(color, move.GetToName(), move.GetFromName());
+      AddPiece(!color, (move.GetToName() +
+                        (color ? senjo::North : senjo::South)));
       break;
     case Move::CastleShort:
-      _board[move.GetToName()] = 0;
-      _board[color ? senjo::Square::H8 : senjo::Square::H1] = (color|Rook);
-      _board[color ? senjo::Square::F8 : senjo::Square::F1] = 0;
+      board[move.GetToName()] = 0;
+      board[color ? senjo::Square::H8 : senjo::Square::H1] = (color|Rook);
+      board[color ? senjo::Square::F8 : senjo::Square::F1] = 0;
+      MovePiece(color, move.GetToName(), move.GetFromName());
+      MovePiece(color, (color ? senjo::Square::F8 : senjo::Square::F1),
+                (color ? senjo::Square::H8 : senjo::Square::H1));
       break;
     case Move::CastleLong:
-      _board[move.GetToName()] = 0;
-      _board[color ? senjo::Square::A8 : senjo::Square::A1] = (color|Rook);
-      _board[color ? senjo::Square::D8 : senjo::Square::D1] = 0;
+      board[move.GetToName()] = 0;
+      board[color ? senjo::Square::A8 : senjo::Square::A1] = (color|Rook);
+      board[color ? senjo::Square::D8 : senjo::Square::D1] = 0;
+      MovePiece(color, move.GetToName(), move.GetFromName());
+      MovePiece(color, (color ? senjo::Square::D8 : senjo::Square::D1),
+                (color ? senjo::Square::A8 : senjo::Square::A1));
       break;
     }
-    _board[move.GetFromName()] = move.GetPc();
-    _seen.erase(positionKey);
+    board[move.GetFromName()] = move.GetPc();
   }
 
   //--------------------------------------------------------------------------
   //! Perform perft search at an innder node
+  //! Children are executed lazily, perft never needs their evaluation.
   //! \returns The number of leaf nodes encountered
   //--------------------------------------------------------------------------
   template<Color color>
   uint64_t PerftSearch(const int depth) {
+    uint64_t count = 0;
+    const bool hashed = (child && (depth > 1) &&
+                         td->ctx->perftTable.IsEnabled());
+    if (hashed && td->ctx->perftTable.Probe(positionKey, depth, count)) {
+      return count;
+    }
+
     GenerateMoves<color, false>(depth);
     if (!child || (depth <= 1)) {
       return moveCount;
     }
 
-    uint64_t count = 0;
-
-    for (; !_stop && (moveIndex < moveCount); ++moveIndex) {
+    for (; !Stopping() && (moveIndex < moveCount); ++moveIndex) {
       const Move& move = moves[moveIndex];
-      Exec<color>(move, *child);
+      Exec<color>(move, *child, true);
       count += child->PerftSearch<!color>(depth - 1);
       Undo<color>(move);
     }
 
+    if (hashed && !Stopping()) {
+      td->ctx->perftTable.Store(positionKey, depth, count);
+    }
     return count;
   }
 
+  //--------------------------------------------------------------------------
+  //! Perform perft search on root moves claimed with NextPerftMove()
+  //! Every perft thread generates the same lexically sorted root move list,
+  //! so a claimed index refers to the same move in every thread.
+  //--------------------------------------------------------------------------
+  template<Color color>
+  void PerftClaimedMoves(const int depth) {
+    int idx;
+    while (!Stopping() && ((idx = NextPerftMove()) < moveCount)) {
+      const Move& move = moves[idx];
+      Exec<color>(move, *child, true);
+      td->ctx->perftCounts[idx] = child->PerftSearch<!color>(depth - 1);
+      Undo<color>(move);
+    }
+  }
+
   //--------------------------------------------------------------------------
   //! Perform perft search at the root node
   //! \returns The number of leaf nodes encountered
   //--------------------------------------------------------------------------
   template<Color color>
   uint64_t PerftSearchRoot(const int depth) {
-    assert(_initialized);
+    assert(td->ctx->initialized);
     assert(ply == 0);
     assert(!parent);
-    assert(child == _node);
+    assert(child == td->node);
 
     if (_debug) {
       PrintBoard();
@@ -2702,10 +3850,26 @@ private:
 
     uint64_t count = 0;
 
-    if (child && (depth > 1)) {
-      for (; !_stop && (moveIndex < moveCount); ++moveIndex) {
+    if (child && (depth > 1) && !td->helpers.empty()) {
+      // split root moves with the helper threads, report once all are done
+      td->ctx->perftNext = 0;
+      td->ctx->perftDepth = depth;
+      memset(td->ctx->perftCounts, 0, sizeof(td->ctx->perftCounts));
+      StartHelpers(HelperPerft);
+      PerftClaimedMoves<color>(depth);
+      JoinHelpers();
+
+      const int searched = std::min<int>(td->ctx->perftNext, moveCount);
+      for (int i = 0; i < searched; ++i) {
+        senjo::Output() << moves[i].ToString() << ' ' << td->ctx->perftCounts[i]
+                        << ' ' << moves[i].GetScore();
+        count += td->ctx->perftCounts[i];
+      }
+    }
+    else if (child && (depth > 1)) {
+      for (; !Stopping() && (moveIndex < moveCount); ++moveIndex) {
         const Move& move = moves[moveIndex];
-        Exec<color>(move, *child);
+        Exec<color>(move, *child, true);
         const uint64_t c = child->PerftSearch<!color>(depth - 1);
         Undo<color>(move);
         senjo::Output() << move.ToString() << ' ' << c << ' ' << move.GetScore();
@@ -2713,7 +3877,7 @@ private:
       }
     }
     else {
-      for (; !_stop && (moveIndex < moveCount); ++moveIndex) {
+      for (; !Stopping() && (moveIndex < moveCount); ++moveIndex) {
         senjo::Output() << moves[moveIndex].ToString() << " 1 "
                         << moves[moveIndex].GetScore();
         count++;
@@ -2739,19 +3903,37 @@ private:
     assert(abs(beta) <= Infinity);
     assert(depth <= 0);
 
-    _stats.qnodes++;
-    if (ply > _seldepth) {
-      _seldepth = ply;
+    td->stats.qnodes++;
+    if (ply > td->seldepth) {
+      td->seldepth = ply;
     }
 
+    ClearMoves();
     pvCount = 0;
     if (IsDraw()) {
-      return _drawScore[color];
+      return td->drawScore[color];
+    }
+
+    // finish evaluation deferred by Exec()
+    const bool check = InCheck<color>();
+    if (lazyEval) {
+      lazyEval = false;
+      if (!check && LazyEval<color>(alpha, beta)) {
+        td->stats.lazyEvals++;
+        if (standPat >= beta) {
+          return standPat;
+        }
+      }
+      else {
+        Evaluate();
+        if (state & Draw) {
+          return td->drawScore[color];
+        }
+      }
     }
 
     // mate distance pruning and standPat beta cutoff
     assert(standPat > (ply - Infinity));
-    const bool check = InCheck<color>();
     int best = (check ? (ply - Infinity) : standPat);
     alpha = std::max<int>(best, alpha);
     beta = std::min<int>((Infinity - ply + 1), beta);
@@ -2761,44 +3943,41 @@ private:
 
     // do we have anything for this position in the transposition table?
     Move firstMove;
-    HashEntry* entry = _tt.Probe(positionKey);
-    if (entry) {
-      switch (entry->GetPrimaryFlag()) {
+    HashEntry entry;
+    if (ProbeHash<color>(entry, firstMove)) {
+      switch (entry.GetPrimaryFlag()) {
       case HashEntry::Checkmate: return (ply - Infinity);
-      case HashEntry::Stalemate: return _drawScore[color];
+      case HashEntry::Stalemate: return td->drawScore[color];
       case HashEntry::UpperBound:
-        firstMove.Init(entry->moveBits, entry->score);
         assert(ValidateMove<color>(firstMove) == 0);
-        if (entry->score <= alpha) {
+        if (entry.score <= alpha) {
           pv[0] = firstMove;
           pvCount = 1;
-          return entry->score;
+          return entry.score;
         }
         break;
       case HashEntry::ExactScore:
-        firstMove.Init(entry->moveBits, entry->score);
         assert(ValidateMove<color>(firstMove) == 0);
         pv[0] = firstMove;
         pvCount = 1;
-        if ((entry->score >= beta) && !firstMove.IsCapOrPromo()) {
-          IncHistory(firstMove, check, entry->depth);
+        if ((entry.score >= beta) && !firstMove.IsCapOrPromo()) {
+          IncHistory(firstMove, check, entry.depth);
           AddKiller(firstMove);
         }
-        return entry->score;
+        return entry.score;
       case HashEntry::LowerBound:
-        firstMove.Init(entry->moveBits, entry->score);
         assert(ValidateMove<color>(firstMove) == 0);
-        if (entry->score >= beta) {
+        if (entry.score >= beta) {
           pv[0] = firstMove;
           pvCount = 1;
           if (!firstMove.IsCapOrPromo()) {
-            IncHistory(firstMove, check, entry->depth);
+            IncHistory(firstMove, check, entry.depth);
             AddKiller(firstMove);
           }
-          return entry->score;
+          return entry.score;
         }
-        if (entry->score > best) {
-          best = entry->score;
+        if (entry.score > best) {
+          best = entry.score;
           if (best > alpha) {
             alpha = best;
           }
@@ -2815,34 +3994,31 @@ private:
 
     // search firstMove if we have it
     const int orig_alpha = alpha;
-    if (firstMove.IsValid()) {
-      _stats.qexecs++;
-      Exec<color>(firstMove, *child);
-      if (!check && !firstMove.IsCapOrPromo() && !child->InCheck<!color>()) {
-        Undo<color>(firstMove);
+    if (firstMove.IsValid() &&
+        (check || firstMove.IsCapOrPromo() || firstMove.GivesCheck()))
+    {
+      td->stats.qexecs++;
+      Exec<color>(firstMove, *child, true);
+      firstMove.Score() = -child->QSearch<!color>(-beta, -alpha, (depth - 1));
+      Undo<color>(firstMove);
+      if (Stopping()) {
+        return beta;
       }
-      else {
-        firstMove.Score() = -child->QSearch<!color>(-beta, -alpha, (depth - 1));
-        Undo<color>(firstMove);
-        if (_stop) {
-          return beta;
-        }
-        if (firstMove.GetScore() > alpha) {
-          alpha = firstMove.GetScore();
-        }
-        if (firstMove.GetScore() > best) {
-          best = firstMove.GetScore();
-          UpdatePV(firstMove);
-          if (firstMove.GetScore() >= beta) {
-            if (!firstMove.IsCapOrPromo()) {
-              AddKiller(firstMove);
-            }
-            if (check) {
-              firstMove.Score() = beta;
-              _tt.Store(positionKey, firstMove, 0, HashEntry::LowerBound, 0);
-            }
-            return best;
+      if (firstMove.GetScore() > alpha) {
+        alpha = firstMove.GetScore();
+      }
+      if (firstMove.GetScore() > best) {
+        best = firstMove.GetScore();
+        UpdatePV(firstMove);
+        if (firstMove.GetScore() >= beta) {
+          if (!firstMove.IsCapOrPromo()) {
+            AddKiller(firstMove);
+          }
+          if (check) {
+            firstMove.Score() = beta;
+            StoreHash(firstMove, 0, HashEntry::LowerBound, 0);
           }
+          return best;
         }
       }
     }
@@ -2852,10 +4028,10 @@ private:
     if (moveCount <= 0) {
       if (check) {
         assert(!firstMove.IsValid());
-        _tt.StoreCheckmate(positionKey);
+        StoreCheckmate();
         return (ply - Infinity);
       }
-      // don't call _tt.StoreStalemate()!!!
+      // don't call StoreStalemate()!!!
       assert(best >= standPat);
       assert(best < beta);
       return best;
@@ -2869,23 +4045,20 @@ private:
         continue;
       }
 
-      _stats.qexecs++;
-      Exec<color>(*move, *child);
-      if (_delta && !check && (depth < 0) && !move->GetPromo() &&
-          ((standPat + ValueOf(move->GetCap()) + _delta) <= alpha) &&
-          !child->InCheck<!color>())
+      if (td->ctx->delta && !check && (depth < 0) && !move->GetPromo() &&
+          ((standPat + ValueOf(move->GetCap()) + td->ctx->delta) <= alpha) &&
+          !move->GivesCheck())
       {
-        _stats.deltaCount++;
-        Undo<color>(*move);
-        if (_stop) {
-          return beta;
-        }
+        td->stats.deltaCount++;
         continue;
       }
 
+      td->stats.qexecs++;
+      Exec<color>(*move, *child, true);
+
       move->Score() = -child->QSearch<!color>(-beta, -alpha, (depth - 1));
       Undo<color>(*move);
-      if (_stop) {
+      if (Stopping()) {
         return beta;
       }
       if (move->GetScore() > alpha) {
@@ -2900,7 +4073,7 @@ private:
           }
           if (check) {
             move->Score() = beta;
-            _tt.Store(positionKey, *move, 0, HashEntry::LowerBound, 0);
+            StoreHash(*move, 0, HashEntry::LowerBound, 0);
           }
           return best;
         }
@@ -2914,14 +4087,14 @@ private:
       if (alpha > orig_alpha) {
         assert(pv[0].GetScore() == alpha);
         assert(beta > (orig_alpha + 1));
-        _tt.Store(positionKey, pv[0], 0, HashEntry::ExactScore,
+        StoreHash(pv[0], 0, HashEntry::ExactScore,
             HashEntry::FromPV);
       }
       else {
         assert(alpha == orig_alpha);
         assert(pv[0].GetScore() <= alpha);
         pv[0].Score() = alpha;
-        _tt.Store(positionKey, pv[0], 0, HashEntry::UpperBound, 0);
+        StoreHash(pv[0], 0, HashEntry::UpperBound, 0);
       }
     }
 
@@ -2943,12 +4116,13 @@ private:
     assert((depth + depthChange) > 0);
     assert((type == PV) || ((alpha + 1) == beta));
 
-    _stats.snodes++;
-    moveCount = 0;
+    td->stats.snodes++;
+    ClearMoves();
+    moveStage = NotStarted;
     pvCount   = 0;
 
     if (IsDraw()) {
-      return _drawScore[color];
+      return td->drawScore[color];
     }
 
     // mate distance pruning
@@ -2963,79 +4137,78 @@ private:
 
     // check extensions
     const bool check = InCheck<color>();
-    if (_ext && check && (depthChange <= 0) && (parent->depthChange <= 0)) {
-      _stats.chkExts++;
+    if (td->ctx->ext && check && (depthChange <= 0) &&
+        (parent->depthChange <= 0))
+    {
+      td->stats.chkExts++;
       depthChange++;
       depth++;
     }
 
     // do we have anything for this position in the transposition table?
     const bool pvNode = (type == PV);
-    HashEntry* entry = _tt.Probe(positionKey);
+    HashEntry entry;
     Move firstMove;
     int eval = standPat;
-    if (entry) {
-      switch (entry->GetPrimaryFlag()) {
+    if (ProbeHash<color>(entry, firstMove)) {
+      switch (entry.GetPrimaryFlag()) {
       case HashEntry::Checkmate: return (ply - Infinity);
-      case HashEntry::Stalemate: return _drawScore[color];
+      case HashEntry::Stalemate: return td->drawScore[color];
       case HashEntry::UpperBound:
-        firstMove.Init(entry->moveBits, entry->score);
         assert(ValidateMove<color>(firstMove) == 0);
-        if ((!pvNode || entry->HasPvFlag()) &&
-            (entry->depth >= depth) && (entry->score <= alpha))
+        if ((!pvNode || entry.HasPvFlag()) &&
+            (entry.depth >= depth) && (entry.score <= alpha))
         {
           pv[0] = firstMove;
           pvCount = 1;
-          return entry->score;
+          return entry.score;
         }
-        if ((entry->depth >= (depth - 3)) && (entry->score < eval)) {
-          eval = entry->score;
+        if ((entry.depth >= (depth - 3)) && (entry.score < eval)) {
+          eval = entry.score;
         }
         break;
       case HashEntry::ExactScore:
-        firstMove.Init(entry->moveBits, entry->score);
-        assert(entry->HasPvFlag());
+        assert(entry.HasPvFlag());
         assert(ValidateMove<color>(firstMove) == 0);
-        if ((entry->depth >= depth) && ((entry->score <= alpha) ||
-                                        (entry->score >= beta)))
+        if ((entry.depth >= depth) && ((entry.score <= alpha) ||
+                                        (entry.score >= beta)))
         {
           pv[0] = firstMove;
           pvCount = 1;
-          if ((entry->score >= beta) && !firstMove.IsCapOrPromo()) {
-            IncHistory(firstMove, check, entry->depth);
+          if ((entry.score >= beta) && !firstMove.IsCapOrPromo()) {
+            IncHistory(firstMove, check, entry.depth);
             AddKiller(firstMove);
           }
-          return entry->score;
+          return entry.score;
         }
-        if (entry->depth >= (depth - 3)) {
-          eval = entry->score;
+        if (entry.depth >= (depth - 3)) {
+          eval = entry.score;
         }
         break;
       case HashEntry::LowerBound:
-        firstMove.Init(entry->moveBits, entry->score);
         assert(ValidateMove<color>(firstMove) == 0);
-        if ((!pvNode || entry->HasPvFlag()) &&
-            (entry->depth >= depth) && (entry->score >= beta))
+        if ((!pvNode || entry.HasPvFlag()) &&
+            (entry.depth >= depth) && (entry.score >= beta))
         {
           pv[0] = firstMove;
           pvCount = 1;
           if (!firstMove.IsCapOrPromo()) {
-            IncHistory(firstMove, check, entry->depth);
+            IncHistory(firstMove, check, entry.depth);
             AddKiller(firstMove);
           }
-          return entry->score;
+          return entry.score;
         }
-        if ((entry->depth >= (depth - 3)) && (entry->score > eval)) {
-          eval = entry->score;
+        if ((entry.depth >= (depth - 3)) && (entry.score > eval)) {
+          eval = entry.score;
         }
         break;
       default:
         assert(false);
       }
-      if (entry->HasExtendedFlag() && (depthChange <= 0) &&
+      if (entry.HasExtendedFlag() && (depthChange <= 0) &&
           (parent->depthChange <= 0))
       {
-        _stats.hashExts++;
+        td->stats.hashExts++;
         depthChange++;
         depth++;
       }
@@ -3045,22 +4218,22 @@ private:
     bool pruneOK = (!pvNode && !check && nullMoveOk && (depthChange <= 0));
 
     // razoring (fail low pruning)
-    if (_rzr && pruneOK && (depth < 4) && (alpha < WinningScore) &&
+    if (td->ctx->rzr && pruneOK && (depth < 4) && (alpha < WinningScore) &&
         // TODO && no pawns on 2nd/7th rank
         !parent->InCheck<!color>() && ((eval + RazorDelta(depth)) <= alpha))
     {
-      _stats.rzrCount++;
+      td->stats.rzrCount++;
       if ((depth <= 1) && ((eval + RazorDelta(3 * depth)) <= alpha)) {
-        _stats.rzrEarlyOut++;
+        td->stats.rzrEarlyOut++;
         return QSearch<color>(alpha, beta, 0);
       }
       const int ralpha = (alpha - RazorDelta(depth));
       const int val = QSearch<color>(ralpha, (ralpha + 1), 0);
-      if (_stop) {
+      if (Stopping()) {
         return beta;
       }
       if (val <= ralpha) {
-        _stats.rzrCutoffs++;
+        td->stats.rzrCutoffs++;
         return val;
       }
     }
@@ -3070,17 +4243,18 @@ private:
                            ((pieceCount[color] + pieceCount[color|Pawn]) > 3)));
 
     // futility pruning (static null move pruning)
-    if (_futility && cutNode && pruneOK && (depth < 7) && // TODO try different max depths
+    // TODO try different max depths
+    if (td->ctx->futility && cutNode && pruneOK && (depth < 7) &&
         ((eval - FutilityDelta(depth)) >= beta))
     {
-      _stats.futility++;
+      td->stats.futility++;
       pvCount = 0;
       return (eval - FutilityDelta(depth));
     }
 
     // null move heuristics
     int searchDepth;
-    if (_nmp && pruneOK && (depth > 1)) {
+    if (td->ctx->nmp && pruneOK && (depth > 1)) {
       assert((alpha + 1) == beta);
       // stand pat if we can get a score >= beta without even making a move
       if (eval >= beta) {
@@ -3091,26 +4265,27 @@ private:
         eval = (searchDepth > 0)
             ? -child->Search<NonPV, !color>(-beta, -alpha, searchDepth, false)
             : -child->QSearch<!color>(-beta, -alpha, 0);
-        if (_stop) {
+        if (Stopping()) {
           return beta;
         }
         if (eval >= beta) {
           // TODO do verification search if depth reduction > 4
-          _stats.nmCutoffs++;
+          td->stats.nmCutoffs++;
           pvCount = 0;
           return (standPat >= beta) ? standPat : beta; // do not return eval
         }
       }
-      else if (_nmr && cutNode && (depth > 2) && !parent->InCheck<!color>() &&
-               (eval >= -parent->standPat) && !lastMove.IsCapOrPromo() &&
+      else if (td->ctx->nmr && cutNode && (depth > 2) &&
+               !parent->InCheck<!color>() && (eval >= -parent->standPat) &&
+               !lastMove.IsCapOrPromo() &&
                !((lastMove.GetPc() == ((!color)|Pawn)) &&
                  (lastMove.GetTo().Y() == (color ? 6 : 1))))
       {
         nmrAttempt = 1;
-        _stats.nmrCandidates++;
+        td->stats.nmrCandidates++;
         ExecNullMove<color>(*child);
         eval = -child->QSearch<!color>(-standPat, (1 - standPat), 0);
-        if (_stop) {
+        if (Stopping()) {
           return beta;
         }
         if (eval >= standPat) {
@@ -3127,7 +4302,7 @@ private:
 //                          << ", " << eval
 //                          << ", " << standPat;
 //          PrintBoard();
-          _stats.nmReductions++;
+          td->stats.nmReductions++;
           depthChange -= (1 + (eval >= -parent->standPat));
           depth -= (1 + (eval >= -parent->standPat));
         }
@@ -3136,37 +4311,39 @@ private:
     nullMoveOk = 0;
 
     // internal iterative deepening if no firstMove in transposition table
-    if (_iid && !check && !firstMove.IsValid() && (beta < Infinity) &&
+    if (td->ctx->iid && !check && !firstMove.IsValid() && (beta < Infinity) &&
         ((beta - 1) > -Infinity) && (depth >= (pvNode ? 4 : 6)))
     {
       assert(!pvCount);
-      _stats.iidCount++;
+      td->stats.iidCount++;
       // subtract depthChange because it will be added again at top of Search()
       searchDepth = (depth - depthChange - (pvNode ? 2 : 4));
       eval = Search<NonPV, color>((beta - 1), beta, searchDepth, true);
-      if (_stop || !pvCount) {
+      if (Stopping() || !pvCount) {
         return eval;
       }
       assert(pv[0].IsValid());
       firstMove = pv[0];
+      moveStage = NotStarted;
     }
 
     // make sure firstMove is populated
+    Move* move;
     if (!firstMove.IsValid()) {
-      GenerateMoves<color, false>(depth);
-      if (moveCount <= 0) {
+      StartMovePicker<color>();
+      if (!(move = GetNextStagedMove<color>())) {
         if (check) {
-          _tt.StoreCheckmate(positionKey);
+          StoreCheckmate();
           return (ply - Infinity);
         }
-        _tt.StoreStalemate(positionKey);
-        return _drawScore[0];
+        StoreStalemate();
+        return td->drawScore[0];
       }
-      firstMove = *GetNextMove();
-      if (_oneReply && (moveCount == 1) && (depthChange <= 0) &&
-          (parent->depthChange <= 0))
+      firstMove = *move;
+      if (td->ctx->oneReply && (moveStage == Evasions) && (moveCount == 1) &&
+          (depthChange <= 0) && (parent->depthChange <= 0))
       {
-        _stats.oneReplyExts++;
+        td->stats.oneReplyExts++;
         depthChange++;
         depth++;
       }
@@ -3184,7 +4361,7 @@ private:
         : -child->QSearch<!color>(-beta, -alpha, 0);
     assert(!pvNode || (child->depthChange >= 0));
     assert((depth + child->depthChange) >= 0);
-    if (_stop) {
+    if (Stopping()) {
       Undo<color>(firstMove);
       return beta;
     }
@@ -3196,12 +4373,12 @@ private:
       child->nullMoveOk = 0;
       child->depthChange = 0;
       eval = -child->Search<type, !color>(-beta, -alpha, (depth - 1), false);
-      if (_stop) {
+      if (Stopping()) {
         Undo<color>(firstMove);
         return beta;
       }
       if ((eval <= alpha) && child->nmrAttempt) {
-        _stats.nmrBackfires++;
+        td->stats.nmrBackfires++;
       }
     }
     Undo<color>(firstMove);
@@ -3220,48 +4397,48 @@ private:
         AddKiller(firstMove);
       }
       firstMove.Score() = beta;
-      _tt.Store(positionKey, firstMove, pvDepth, HashEntry::LowerBound,
+      StoreHash(firstMove, pvDepth, HashEntry::LowerBound,
                 (((depthChange > 0) ? HashEntry::Extended : 0) |
                  (pvNode ? HashEntry::FromPV : 0)));
       return best;
     }
 
-    // generate moves if we haven't done so already
-    if (moveCount <= 0) {
-      GenerateMoves<color, false>(depth);
-      assert(moveCount > 0);
-      if (_oneReply && (moveCount == 1) && (depthChange <= 0) &&
-          (parent->depthChange <= 0))
+    // start move selection if we haven't done so already
+    if (moveStage == NotStarted) {
+      StartMovePicker<color>();
+      if (td->ctx->oneReply && (moveStage == Evasions) && (moveCount == 1) &&
+          (depthChange <= 0) && (parent->depthChange <= 0))
       {
-        _stats.oneReplyExts++;
+        td->stats.oneReplyExts++;
         depthChange++;
         depth++;
       }
     }
 
     // search remaining moves
-    const bool lmr_ok = (_lmr && (cutNode | !pvNode) && !check && (depth > 2));
-    Move* move;
-    moveIndex = 0;
-    while ((move = GetNextMove())) {
+    const bool lmr_ok = (td->ctx->lmr && (cutNode | !pvNode) && !check &&
+                         (depth > 2));
+    int moveNumber = 1;
+    while ((move = GetNextStagedMove<color>())) {
       if (firstMove == (*move)) {
         assert(firstMove.IsValid());
         continue;
       }
+      moveNumber++;
 
       Exec<color>(*move, *child);
 
       // late move reductions
-      _stats.lateMoves++;
-      if (lmr_ok) _stats.lmCandidates++;
+      td->stats.lateMoves++;
+      if (lmr_ok) td->stats.lmCandidates++;
       if (lmr_ok &&
           !move->IsCapOrPromo() &&
           !IsKiller(*move) &&
-          (_hist[move->GetHistoryIndex()] < 0) &&
-          (!pvNode || (moveIndex > 7)) &&
-          !child->InCheck<!color>())
+          (td->hist[move->GetHistoryIndex()] < 0) &&
+          (!pvNode || (moveNumber > 7)) &&
+          !move->GivesCheck())
       {
-        _stats.lmReductions++;
+        td->stats.lmReductions++;
         child->depthChange = -(1 + (!pvNode &&
                                     (-child->standPat <= -parent->standPat)));
       }
@@ -3277,41 +4454,41 @@ private:
           : -child->QSearch<!color>(-(alpha + 1), -alpha, 0);
 
       // re-search at full depth?
-      if (!_stop && (child->depthChange < 0) && (eval > alpha)) {
+      if (!Stopping() && (child->depthChange < 0) && (eval > alpha)) {
         assert(depth > 1);
-        _stats.lmResearches++;
+        td->stats.lmResearches++;
         child->nullMoveOk = 0;
         child->depthChange = 0;
         eval = -child->Search<NonPV, !color>(-(alpha + 1), -alpha, (depth - 1), false);
-        if (!_stop) {
+        if (!Stopping()) {
           if (eval > alpha) {
-            _stats.lmConfirmed++;
+            td->stats.lmConfirmed++;
           }
           else if (child->nmrAttempt) {
-            _stats.nmrBackfires++;
+            td->stats.nmrBackfires++;
           }
         }
       }
 
       // re-search with full window?
-      if (!_stop && pvNode && (eval > alpha)) {
+      if (!Stopping() && pvNode && (eval > alpha)) {
         assert(child->depthChange >= 0);
         child->nullMoveOk = 0;
         eval = (depth > 1)
             ? -child->Search<type, !color>(-beta, -alpha, (depth - 1), false)
             : -child->QSearch<!color>(-beta, -alpha, 0);
-        if (!_stop && (eval <= alpha) && child->nmrAttempt) {
-          _stats.nmrBackfires++;
+        if (!Stopping() && (eval <= alpha) && child->nmrAttempt) {
+          td->stats.nmrBackfires++;
         }
       }
 
       Undo<color>(*move);
-      if (_stop) {
+      if (Stopping()) {
         return beta;
       }
       if (eval > alpha) {
         alpha = eval;
-        _stats.lmAlphaIncs++;
+        td->stats.lmAlphaIncs++;
         assert(child->depthChange >= 0);
       }
       else if (!move->IsCapOrPromo()) {
@@ -3328,7 +4505,7 @@ private:
             AddKiller(*move);
           }
           move->Score() = beta;
-          _tt.Store(positionKey, *move, pvDepth, HashEntry::LowerBound,
+          StoreHash(*move, pvDepth, HashEntry::LowerBound,
                     (((depthChange > 0) ? HashEntry::Extended : 0) |
                      (pvNode ? HashEntry::FromPV : 0)));
           return best;
@@ -3348,14 +4525,14 @@ private:
         if (!pv[0].IsCapOrPromo()) {
           IncHistory(pv[0], check, pvDepth);
         }
-        _tt.Store(positionKey, pv[0], pvDepth, HashEntry::ExactScore,
+        StoreHash(pv[0], pvDepth, HashEntry::ExactScore,
             (((depthChange > 0) ? HashEntry::Extended : 0) |
              HashEntry::FromPV));
       }
       else {
         assert(alpha == orig_alpha);
         assert(pvDepth <= depth);
-        _tt.Store(positionKey, pv[0], pvDepth, HashEntry::UpperBound,
+        StoreHash(pv[0], pvDepth, HashEntry::UpperBound,
             (((depthChange > 0) ? HashEntry::Extended : 0) |
              (pvNode ? HashEntry::FromPV : 0)));
       }
@@ -3376,31 +4553,34 @@ private:
   //--------------------------------------------------------------------------
   template<Color color>
   std::string SearchRoot(const int depth) {
-    assert(_initialized);
+    assert(td->ctx->initialized);
     assert(ply == 0);
     assert(!parent);
-    assert(child == _node);
+    assert(child == td->node);
 
     depthChange = 0;
     nullMoveOk  = 0;
 
-    if (_debug) {
+    if (_debug && !td->id) {
       PrintBoard();
       senjo::Output() << GetFEN();
     }
 
     GenerateMoves<color, false>(1);
     if (moveCount <= 0) {
-      senjo::Output() << "No legal moves";
+      if (!td->id) {
+        senjo::Output() << "No legal moves";
+      }
       return std::string();
     }
     while (GetNextMove()) { ; } // sort 'em
 
     // move transposition table move (if any) to front of list
     if (moveCount > 1) {
-      HashEntry* entry = _tt.Probe(positionKey);
-      if (entry) {
-        switch (entry->GetPrimaryFlag()) {
+      HashEntry entry;
+      Move ttMove;
+      if (ProbeHash<color>(entry, ttMove)) {
+        switch (entry.GetPrimaryFlag()) {
         case HashEntry::Checkmate:
         case HashEntry::Stalemate:
           assert(false);
@@ -3408,7 +4588,6 @@ private:
         case HashEntry::UpperBound:
         case HashEntry::ExactScore:
         case HashEntry::LowerBound: {
-          const Move ttMove(entry->moveBits, entry->score);
           assert(ValidateMove<color>(ttMove) == 0);
           for (int i = 0; i < moveCount; ++i) {
             if (moves[i] == ttMove) {
@@ -3440,41 +4619,43 @@ private:
     int   delta;
 
     // iterative deepening
-    for (int d = 0; !_stop && (d < depth); ++d) {
-      _seldepth = _depth = (d + 1);
+    // odd numbered helper threads start 1 ply deeper than the main thread
+    for (int d = (td->id & 1); !Stopping() && (d < depth); ++d) {
+      td->seldepth = td->depth = (d + 1);
 
       newPV = true;
-      delta = (_depth < 5) ? HugeDelta : 25;
+      delta = (td->depth < 5) ? HugeDelta : 25;
       alpha = std::max<int>((best - delta), -Infinity);
       beta  = std::min<int>((best + delta), +Infinity);
 
-      for (moveIndex = 0; !_stop && (moveIndex < moveCount); ++moveIndex) {
+      for (moveIndex = 0; !Stopping() && (moveIndex < moveCount); ++moveIndex) {
         move      = (moves + moveIndex);
-        _currmove = move->ToString();
-        _movenum  = (moveIndex + 1);
+        td->currmove = move->ToString();
+        td->movenum  = (moveIndex + 1);
 
         child->depthChange = 0;
         child->nullMoveOk = 1;
         Exec<color>(*move, *child);
-        move->Score() = (_depth > 1)
-            ? ((_movenum == 1)
-               ? -child->Search<PV, !color>(-beta, -alpha, (_depth - 1), false)
-               : -child->Search<NonPV, !color>(-beta, -alpha, (_depth - 1), true))
+        move->Score() = (td->depth > 1)
+            ? ((td->movenum == 1)
+               ? -child->Search<PV, !color>(-beta, -alpha, (td->depth - 1), false)
+               : -child->Search<NonPV, !color>(-beta, -alpha, (td->depth - 1), true))
             : -child->QSearch<!color>(-beta, -alpha, 0);
-        assert(move->GetScore() > -Infinity);
-        assert(move->GetScore() < Infinity);
-        if (_stop) {
+        // a stopped child returns a window bound, which may be +/-Infinity
+        if (Stopping()) {
           Undo<color>(*move);
           break;
         }
+        assert(move->GetScore() > -Infinity);
+        assert(move->GetScore() < Infinity);
 
         // re-search to get real score?
         if ((move->GetScore() >= beta) ||
-            ((move->GetScore() <= alpha) && (_movenum == 1)))
+            ((move->GetScore() <= alpha) && (td->movenum == 1)))
         {
           int bound[2] = { -Infinity, Infinity };
           newPV = true;
-          delta = (_depth < 5) ? HugeDelta : 100;
+          delta = (td->depth < 5) ? HugeDelta : 100;
           do {
             if (move->GetScore() >= beta) {
               OutputPV(move->GetScore(), 1); // report lowerbound
@@ -3484,7 +4665,7 @@ private:
             else {
               assert(move->GetScore() <= alpha);
               OutputPV(move->GetScore(), -1); // report upperbound
-              if (_movenum == 1) {
+              if (td->movenum == 1) {
                 alpha = std::max<int>(-Infinity, (move->GetScore() - delta));
               }
               else {
@@ -3494,15 +4675,15 @@ private:
             }
             child->depthChange = 0;
             child->nullMoveOk = 0;
-            move->Score() = (_depth > 1)
-                ? -child->Search<PV, !color>(-beta, -alpha, (_depth - 1), false)
+            move->Score() = (td->depth > 1)
+                ? -child->Search<PV, !color>(-beta, -alpha, (td->depth - 1), false)
                 : -child->QSearch<!color>(-beta, -alpha, 0);
-            assert(move->GetScore() > -Infinity);
-            assert(move->GetScore() < Infinity);
-            if (_stop) {
+            if (Stopping()) {
               break;
             }
-            if ((_movenum > 1) && (move->GetScore() <= best)) {
+            assert(move->GetScore() > -Infinity);
+            assert(move->GetScore() < Infinity);
+            if ((td->movenum > 1) && (move->GetScore() <= best)) {
               newPV = false;
               break;
             }
@@ -3514,8 +4695,10 @@ private:
             }
             else {
               // TODO increase time
-              senjo::Output() << "UNSTABLE(" << move->GetScore() << ", "
-                              << bound[0] << ", " << bound[1] << ")";
+              if (!td->id) {
+                senjo::Output() << "UNSTABLE(" << move->GetScore() << ", "
+                                << bound[0] << ", " << bound[1] << ")";
+              }
               break;
             }
             if (abs(move->GetScore()) >= 1000) {
@@ -3530,11 +4713,11 @@ private:
           newPV = false;
           showPV = false;
           UpdatePV(*move);
-          if (!_stop &&
+          if (!Stopping() &&
               (move->GetScore() > alpha) && (move->GetScore() < beta))
           {
             OutputPV(move->GetScore());
-            _tt.Store(positionKey, *move, _depth, HashEntry::ExactScore,
+            StoreHash(*move, td->depth, HashEntry::ExactScore,
                       HashEntry::FromPV);
           }
 
@@ -3558,16 +4741,15 @@ private:
   //! Initialize search variables
   //--------------------------------------------------------------------------
   void InitSearch() {
-    _currmove.clear();
-    _stats.Clear();
-    _tt.ResetCounters();
+    td->currmove.clear();
+    td->stats.Clear();
 
-    _depth    = 0;
-    _movenum  = 0;
-    _seldepth = 0;
+    td->depth    = 0;
+    td->movenum  = 0;
+    td->seldepth = 0;
 
-    _drawScore[ColorToMove()] = -_contempt;
-    _drawScore[!ColorToMove()] = _contempt;
+    td->drawScore[ColorToMove()] = -td->ctx->contempt;
+    td->drawScore[!ColorToMove()] = td->ctx->contempt;
   }
 };
 
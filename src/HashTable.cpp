@@ -21,13 +21,416 @@
 //----------------------------------------------------------------------------
 
 #include "HashTable.h"
+#include "senjo/src/Threading.h"
+
+#include <new>
+#include <utility>
+
+#ifndef _WIN32
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
 
 namespace clubfoot {
 
-uint64_t TranspositionTable::_stores = 0;
-uint64_t TranspositionTable::_hits = 0;
-uint64_t TranspositionTable::_checkmates = 0;
-uint64_t TranspositionTable::_stalemates = 0;
+//----------------------------------------------------------------------------
+//! Tables at least this big are aligned on (and sized in multiples of) the
+//! common 2MB huge page size.  Smaller tables are only cache line aligned.
+//----------------------------------------------------------------------------
+static const size_t _HUGE_PAGE_SIZE = (2 * 1024 * 1024);
+
+//----------------------------------------------------------------------------
+//! Parameters for one TranspositionTable::ClearRange thread
+//----------------------------------------------------------------------------
+struct ClearParams {
+  char* begin;
+  size_t size;
+};
+
+//----------------------------------------------------------------------------
+//! Header at the start of files written by TranspositionTable::Save
+//! The header is one bucket in size so buckets that follow it in a memory
+//! mapped file are cache line aligned.
+//----------------------------------------------------------------------------
+struct HashFileHeader {
+  char     magic[8];     // "CFHASH\0" + format version
+  uint32_t entrySize;    // sizeof(HashEntry)
+  uint32_t bucketSize;   // sizeof(HashBucket)
+  uint32_t bucketCount;  // number of entries per bucket
+  uint32_t generation;   // table generation when saved
+  uint64_t salt;         // table salt when saved
+  uint64_t buckets;      // number of buckets that follow the header
+  char     unused[24];
+};
+
+static_assert(sizeof(HashFileHeader) == sizeof(HashBucket),
+              "HashFileHeader must be the same size as HashBucket");
+
+static const char _HASH_FILE_MAGIC[8] = { 'C','F','H','A','S','H','\0','\1' };
+
+//----------------------------------------------------------------------------
+bool TranspositionTable::Resize(const size_t mbytes, const int threads)
+{
+  Free();
+
+  if (!mbytes) {
+    return true;
+  }
+
+  // convert mbytes to bytes
+  const size_t bytes = (mbytes * 1024 * 1024);
+
+  // how many hash buckets can we fit into the requested number of bytes?
+  const size_t count = (bytes / sizeof(HashBucket));
+
+  // get high bit of 'count + 1'
+  // for example, if 'count + 1' in binary is: 100110101
+  //                    the high bit would be: 100000000
+  // NOTE: there are faster ways to do this on modern processors
+  size_t highBit = 1;
+  for (size_t tmp = ((count + 1) >> 1); tmp; tmp >>= 1) {
+    highBit <<= 1;
+  }
+
+  // if highBit is 0 we've shifted beyond size_t bit count (e.g. too big!)
+  if (!highBit) {
+    return false;
+  }
+
+  // highBit is the number of buckets we'll store
+  // highBit - 1 is the bit mask we use to map position keys to a bucket
+  // example highBit in binary: 100000000
+  //                      mask: 011111111
+  if (!(highBit - 1) || !Allocate(sizeof(HashBucket) * highBit)) {
+    return false;
+  }
+
+  keyMask = (highBit - 1);
+  buckets = reinterpret_cast<HashBucket*>(memory);
+
+  // initialize it
+  Clear(threads);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool PerftTable::Resize(const size_t mbytes)
+{
+  delete[] slots;
+  slots = NULL;
+  keyMask = 0;
+
+  if (!mbytes) {
+    return true;
+  }
+
+  // use the largest power of 2 slot count that fits in mbytes
+  const size_t count = ((mbytes * 1024 * 1024) / sizeof(Slot));
+  size_t highBit = 1;
+  while ((highBit << 1) && ((highBit << 1) <= count)) {
+    highBit <<= 1;
+  }
+
+  slots = new(std::nothrow) Slot[highBit];
+  if (!slots) {
+    return false;
+  }
+
+  keyMask = (highBit - 1);
+  Clear();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool EvalCache::Resize(const size_t mbytes)
+{
+  delete[] slots;
+  slots = NULL;
+  keyMask = 0;
+
+  if (!mbytes) {
+    return true;
+  }
+
+  // use the largest power of 2 slot count that fits in mbytes
+  const size_t count = ((mbytes * 1024 * 1024) / sizeof(uint64_t));
+  size_t highBit = 1;
+  while ((highBit << 1) && ((highBit << 1) <= count)) {
+    highBit <<= 1;
+  }
+
+  slots = new(std::nothrow) uint64_t[highBit];
+  if (!slots) {
+    return false;
+  }
+
+  keyMask = (highBit - 1);
+  Clear();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void TranspositionTable::Clear(const int threads)
+{
+  if (!buckets) {
+    return;
+  }
+
+  // give each thread a whole number of pages
+  const size_t bytes = (sizeof(HashBucket) * (keyMask + 1));
+  const size_t page = ((bytes >= _HUGE_PAGE_SIZE) ? _HUGE_PAGE_SIZE
+                                                  : sizeof(HashBucket));
+  const size_t pages = (bytes / page);
+  const size_t count = std::max<size_t>(
+      1, std::min<size_t>(static_cast<size_t>(std::max<int>(threads, 1)),
+                          pages));
+
+  ClearParams* params = new ClearParams[count];
+  senjo::Thread* thread = new senjo::Thread[count];
+  char* begin = memory;
+  for (size_t i = 0; i < count; ++i) {
+    const size_t chunk = (page * (((i + 1) * pages / count) -
+                                  (i * pages / count)));
+    params[i].begin = begin;
+    params[i].size = chunk;
+    begin += chunk;
+  }
+  assert(begin == (memory + bytes));
+
+  // the calling thread clears the first chunk
+  for (size_t i = 1; i < count; ++i) {
+    if (!thread[i].Start(ClearRange, (params + i))) {
+      ClearRange(params + i);
+    }
+  }
+  ClearRange(params);
+  for (size_t i = 1; i < count; ++i) {
+    thread[i].Join();
+  }
+
+  delete[] thread;
+  delete[] params;
+}
+
+//----------------------------------------------------------------------------
+void TranspositionTable::ClearRange(void* range)
+{
+  const ClearParams* params = static_cast<ClearParams*>(range);
+  memset(params->begin, 0, params->size);
+}
+
+//----------------------------------------------------------------------------
+bool TranspositionTable::Save(const std::string& path) const
+{
+  if (!buckets || path.empty()) {
+    return false;
+  }
+
+  HashFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, _HASH_FILE_MAGIC, sizeof(header.magic));
+  header.entrySize = sizeof(HashEntry);
+  header.bucketSize = sizeof(HashBucket);
+  header.bucketCount = HashBucket::Size;
+  header.generation = static_cast<uint32_t>(generation);
+  header.salt = salt;
+  header.buckets = (keyMask + 1);
+
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  if (ok) {
+    ok = (fwrite(buckets, sizeof(HashBucket), (keyMask + 1), fp) ==
+          (keyMask + 1));
+  }
+  if (fclose(fp)) {
+    ok = false;
+  }
+  if (!ok) {
+    remove(path.c_str());
+  }
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+bool TranspositionTable::Load(const std::string& path)
+{
+  if (path.empty()) {
+    return false;
+  }
+
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+
+  // validate the header against this build's entry format and the file size
+  HashFileHeader header;
+  bool ok = (fread(&header, sizeof(header), 1, fp) == 1) &&
+      !memcmp(header.magic, _HASH_FILE_MAGIC, sizeof(header.magic)) &&
+      (header.entrySize == sizeof(HashEntry)) &&
+      (header.bucketSize == sizeof(HashBucket)) &&
+      (header.bucketCount == HashBucket::Size) &&
+      !(header.generation & ~HashEntry::GenerationMask) &&
+      header.buckets && !(header.buckets & (header.buckets - 1)) &&
+      (header.buckets <= (SIZE_MAX / sizeof(HashBucket)));
+
+  const size_t bytes = (ok ? (sizeof(HashBucket) * header.buckets) : 0);
+  if (ok) {
+#ifdef _WIN32
+    ok = (!_fseeki64(fp, 0, SEEK_END) &&
+          (static_cast<uint64_t>(_ftelli64(fp)) == (sizeof(header) + bytes)));
+#else
+    ok = (!fseeko(fp, 0, SEEK_END) &&
+          (static_cast<uint64_t>(ftello(fp)) == (sizeof(header) + bytes)));
+#endif
+  }
+  if (!ok) {
+    fclose(fp);
+    return false;
+  }
+
+  // load into a separate table so the current table survives a failure
+  TranspositionTable loaded;
+
+#ifndef _WIN32
+  // map the file copy-on-write, the header is included in the mapping
+  // to keep the offset of the buckets within the file page aligned
+  void* addr = mmap(NULL, (sizeof(header) + bytes), (PROT_READ | PROT_WRITE),
+                    MAP_PRIVATE, fileno(fp), 0);
+  if (addr != MAP_FAILED) {
+    loaded.memory = static_cast<char*>(addr);
+    loaded.memSize = (sizeof(header) + bytes);
+    loaded.memType = FileMemory;
+    loaded.buckets =
+        reinterpret_cast<HashBucket*>(loaded.memory + sizeof(header));
+  }
+#endif
+
+  // otherwise read the file into newly allocated table memory
+  if (!loaded.buckets) {
+    if (!loaded.Allocate(bytes)) {
+      fclose(fp);
+      return false;
+    }
+    loaded.buckets = reinterpret_cast<HashBucket*>(loaded.memory);
+    if (fseek(fp, sizeof(header), SEEK_SET) ||
+        (fread(loaded.buckets, sizeof(HashBucket), header.buckets, fp) !=
+         header.buckets))
+    {
+      fclose(fp);
+      return false;
+    }
+  }
+
+  fclose(fp);
+
+  // take the loaded memory, the old memory is released with 'loaded'
+  std::swap(memory, loaded.memory);
+  std::swap(memSize, loaded.memSize);
+  std::swap(memType, loaded.memType);
+  std::swap(buckets, loaded.buckets);
+  keyMask = static_cast<size_t>(header.buckets - 1);
+  salt = header.salt;
+  generation = static_cast<int>(header.generation);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool TranspositionTable::Allocate(const size_t bytes)
+{
+  assert(!memory && !memSize && (memType == NoMemory));
+
+#ifdef _WIN32
+  const size_t largePage = GetLargePageMinimum();
+  if (largePage && !(bytes % largePage)) {
+    // only succeeds if the user has the "Lock pages in memory" privilege
+    memory = static_cast<char*>(VirtualAlloc(
+        NULL, bytes, (MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES),
+        PAGE_READWRITE));
+    if (memory) {
+      memType = HugeMemory;
+    }
+  }
+  if (!memory) {
+    memory = static_cast<char*>(_aligned_malloc(bytes, sizeof(HashBucket)));
+    if (memory) {
+      memType = HeapMemory;
+    }
+  }
+#else
+  const bool huge = !(bytes % _HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+  // only succeeds if huge pages have been reserved by the administrator
+  if (huge) {
+    void* addr = mmap(NULL, bytes, (PROT_READ | PROT_WRITE),
+                      (MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB), -1, 0);
+    if (addr != MAP_FAILED) {
+      memory = static_cast<char*>(addr);
+      memType = HugeMemory;
+    }
+  }
+#endif
+  if (!memory) {
+    void* addr = NULL;
+    if (!posix_memalign(&addr, (huge ? _HUGE_PAGE_SIZE : sizeof(HashBucket)),
+                        bytes))
+    {
+      memory = static_cast<char*>(addr);
+      memType = HeapMemory;
+#ifdef MADV_HUGEPAGE
+      // ask for transparent huge pages, it's fine if the OS says no
+      if (huge) {
+        madvise(addr, bytes, MADV_HUGEPAGE);
+      }
+#endif
+    }
+  }
+#endif
+
+  if (!memory) {
+    memType = NoMemory;
+    return false;
+  }
+
+  memSize = bytes;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void TranspositionTable::Free()
+{
+  switch (memType) {
+  case NoMemory:
+    break;
+  case HeapMemory:
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+    break;
+  case HugeMemory:
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, memSize);
+#endif
+    break;
+  case FileMemory:
+#ifndef _WIN32
+    munmap(memory, memSize);
+#endif
+    break;
+  }
+  memSize = 0;
+  memType = NoMemory;
+  memory = NULL;
+  buckets = NULL;
+  keyMask = 0ULL;
+}
 
 //----------------------------------------------------------------------------
 const uint64_t _HASH[14][128] =
@@ -27,6 +27,10 @@
 #include "Types.h"
 #include "Move.h"
 
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
 namespace clubfoot
 {
 
@@ -36,11 +40,11 @@ namespace clubfoot
 extern const uint64_t _HASH[14][128];
 
 //----------------------------------------------------------------------------
-//! \brief 64-bit transposition table entry
-//! NOTE: positionKey could be reduced to 32 bit (only store 32 high order
-//! bits of position Key for collision detection), freeing up 32 bits for
-//! other data.
+//! \brief 80-bit transposition table entry
+//! Only the 32 high order bits of the position key are stored (the low order
+//! bits select the bucket) and the best move is stored in compact form.
 //----------------------------------------------------------------------------
+#pragma pack(push, 2)
 struct HashEntry
 {
 public:
@@ -56,7 +60,11 @@ public:
     // other flags
     Extended    = 0x08,
     FromPV      = 0x10,
-    OtherMask   = 0x18
+    OtherMask   = 0x18,
+
+    // search generation that stored the entry
+    GenerationMask = 0xE0,
+    GenerationInc  = 0x20
   };
 
   //--------------------------------------------------------------------------
@@ -80,15 +88,65 @@ public:
     return (flags & HashEntry::FromPV);
   }
 
-  uint64_t positionKey;
-  uint32_t moveBits;
+  //--------------------------------------------------------------------------
+  //! \return All fields except 'check' folded into a single value
+  //--------------------------------------------------------------------------
+  uint32_t GetData() const {
+    return (static_cast<uint32_t>(move) |
+            (static_cast<uint32_t>(static_cast<uint16_t>(score)) << 16)) ^
+           (static_cast<uint32_t>(depth) | (static_cast<uint32_t>(flags) << 8));
+  }
+
+  uint32_t check; // high 32 bits of position key ^ GetData()
+  uint16_t move;  // compact best move (see Move::GetCompactBits)
   int16_t  score;
   uint8_t  depth;
   uint8_t  flags;
 };
+#pragma pack(pop)
+
+//----------------------------------------------------------------------------
+//! \brief A cache line sized group of transposition table entries
+//----------------------------------------------------------------------------
+struct HashBucket
+{
+  enum {
+    Size = 6 // number of entries per bucket
+  };
+
+  HashEntry entry[Size];
+  uint32_t  unused;
+};
+
+static_assert(sizeof(HashBucket) == 64, "HashBucket must fill a cache line");
+
+//----------------------------------------------------------------------------
+//! \brief Pawn hash table entry
+//! Holds the part of pawn structure evaluation that depends only on the
+//! location of pawns.  Pawn evaluation terms that depend on whether the
+//! square in front of a pawn is occupied by a non-pawn piece are kept as a
+//! list of (square, value) pairs to apply against the current board.
+//----------------------------------------------------------------------------
+struct PawnHashEntry
+{
+  enum {
+    MaxBlocks = 16 // one potential blocker per pawn
+  };
+
+  uint64_t key;                  // pawn key of the pawn structure
+  uint64_t passers[2];           // semi-passer and passer square masks
+  int16_t  score;                // pawn score from white's perspective
+  uint8_t  blockCount;           // number of entries in blockSqr/blockVal
+  uint8_t  blockSqr[MaxBlocks];  // squares in front of pawns
+  int8_t   blockVal[MaxBlocks];  // subtract from score if blockSqr occupied
+  char     openFile[2][8];       // files with no pawns (per color)
+};
 
 //----------------------------------------------------------------------------
 //! \brief The transposition table
+//! Position keys map to a bucket of entries, any entry in the bucket may hold
+//! the position.  Each search increments the table generation so entries
+//! from previous searches can be identified and replaced first.
 //----------------------------------------------------------------------------
 class TranspositionTable
 {
@@ -98,95 +156,125 @@ public:
   //--------------------------------------------------------------------------
   TranspositionTable()
     : keyMask(0ULL),
-      entries(NULL)
+      salt(0ULL),
+      generation(0),
+      memSize(0),
+      memType(NoMemory),
+      memory(NULL),
+      buckets(NULL)
   { }
 
   //--------------------------------------------------------------------------
   //! Destructor
   //--------------------------------------------------------------------------
   ~TranspositionTable() {
-    delete[] entries;
-    entries = NULL;
-    keyMask = 0ULL;
+    Free();
   }
 
   //--------------------------------------------------------------------------
   //! Resize the table, this also clears the contents of the table
   //! \param mbytes The maximum number of megabytes the table will hold
+  //! \param threads The number of threads to use when clearing the table
   //! \return false if the requested size could not be allocated
   //--------------------------------------------------------------------------
-  bool Resize(const size_t mbytes) {
-    delete[] entries;
-    entries = NULL;
-    keyMask = 0ULL;
+  bool Resize(const size_t mbytes, const int threads = 1);
 
-    if (!mbytes) {
-      return true;
-    }
-
-    // convert mbytes to bytes
-    const size_t bytes = (mbytes * 1024 * 1024);
-
-    // how many hash entries can we fit into the requested number of bytes?
-    const size_t count = (bytes / sizeof(HashEntry));
+  //--------------------------------------------------------------------------
+  //! Clear contents of the table
+  //! The table is divided into contiguous page aligned chunks that are each
+  //! cleared by a separate thread, so on NUMA systems the pages of each chunk
+  //! are first touched (and therefore placed) on the node of the thread that
+  //! cleared it.
+  //! \param threads The number of threads to use
+  //--------------------------------------------------------------------------
+  void Clear(const int threads = 1);
 
-    // get high bit of 'count + 1'
-    // for example, if 'count + 1' in binary is: 100110101
-    //                    the high bit would be: 100000000
-    // NOTE: there are faster ways to do this on modern processors
-    size_t highBit = 1;
-    for (size_t tmp = ((count + 1) >> 1); tmp; tmp >>= 1) {
-      highBit <<= 1;
-    }
+  //--------------------------------------------------------------------------
+  //! Write the contents of the table to a file
+  //! \param path Path of the file to write
+  //! \return false if the file could not be written
+  //--------------------------------------------------------------------------
+  bool Save(const std::string& path) const;
 
-    // if highBit is 0 we've shifted beyond size_t bit count (e.g. too big!)
-    if (!highBit) {
-      return false;
-    }
+  //--------------------------------------------------------------------------
+  //! Replace the table with the contents of a file created by Save()
+  //! Where supported the file is memory mapped copy-on-write and used as the
+  //! table memory directly, so the file is never parsed or modified.
+  //! The table is unchanged if the file is missing, invalid or cannot be
+  //! read into memory.
+  //! \param path Path of the file to read
+  //! \return false if the file could not be loaded
+  //--------------------------------------------------------------------------
+  bool Load(const std::string& path);
 
-    // highBit is the number of entries we'll store
-    // highBit - 1 is the bit mask we use to map position keys to a table slot
-    // example highBit in binary: 100000000
-    //                      mask: 011111111
-    keyMask = (highBit - 1);
-    if (!keyMask) {
-      return false;
-    }
+  //--------------------------------------------------------------------------
+  //! Get the size of the table
+  //! \return The size of the table in megabytes
+  //--------------------------------------------------------------------------
+  size_t GetMegabytes() const {
+    return (buckets ? ((sizeof(HashBucket) * (keyMask + 1)) >> 20) : 0);
+  }
 
-    // allocate it
-    if (!(entries = new HashEntry[keyMask + 1])) {
-      return false;
-    }
+  //--------------------------------------------------------------------------
+  //! Invalidate contents of the table without touching the table memory
+  //! Entries are stored with key check values XOR-ed against a table salt, so
+  //! changing the salt makes every existing entry fail verification.
+  //! Changing the generation marks existing entries for early replacement.
+  //--------------------------------------------------------------------------
+  void Invalidate() {
+    salt += 0x9E3779B97F4A7C15ULL;
+    generation = ((generation + (4 * HashEntry::GenerationInc)) &
+                  HashEntry::GenerationMask);
+  }
 
-    // initialize it
-    Clear();
-    return true;
+  //--------------------------------------------------------------------------
+  //! Start a new search generation, call this at the start of each search
+  //--------------------------------------------------------------------------
+  void NextGeneration() {
+    generation = ((generation + HashEntry::GenerationInc) &
+                  HashEntry::GenerationMask);
   }
 
   //--------------------------------------------------------------------------
-  //! Clear contents of the table
+  //! Start loading the bucket for the given position key into cache
+  //! Call this as soon as a position key is known so the (likely) cache miss
+  //! overlaps other work done before the position is probed.
+  //! \param key The position key
   //--------------------------------------------------------------------------
-  void Clear() {
-    ResetCounters();
-    if (entries) {
-      memset(entries, 0, (sizeof(HashEntry) * (keyMask + 1)));
+  void Prefetch(const uint64_t key) const {
+    if (buckets) {
+#if defined(_MSC_VER)
+      _mm_prefetch(reinterpret_cast<const char*>(buckets + (key & keyMask)),
+                   _MM_HINT_T0);
+#elif defined(__GNUC__)
+      __builtin_prefetch(buckets + (key & keyMask));
+#endif
     }
   }
 
   //--------------------------------------------------------------------------
-  //! Get the hash entry the given position key maps to
+  //! Get a copy of the hash entry for the given position key
+  //! Entries are stored with the key check value XOR-ed against the rest of
+  //! the entry data so entries torn by concurrent writes from other search
+  //! threads fail verification instead of mixing data from two positions.
+  //! NOTE: only 32 bits of key are verified, so the entry move may not be
+  //!       legal in the position.
   //! \param key The position key
-  //! \return NULL if no entry exists for the given \p key
-  //--------------------------------------------------------------------------
-  HashEntry* Probe(const uint64_t key) {
-    if (key && entries) {
-      HashEntry* entry = (entries + (key & keyMask));
-      if (entry->positionKey == key) {
-        _hits++;
-        return entry;
+  //! \param entry Receives a copy of the entry
+  //! \return false if no entry exists for the given \p key
+  //--------------------------------------------------------------------------
+  bool Probe(const uint64_t key, HashEntry& entry) {
+    if (key && buckets) {
+      const uint32_t check = Check(key);
+      const HashBucket& bucket = buckets[key & keyMask];
+      for (int i = 0; i < HashBucket::Size; ++i) {
+        entry = bucket.entry[i];
+        if (entry.flags && ((entry.check ^ entry.GetData()) == check)) {
+          return true;
+        }
       }
     }
-    return NULL;
+    return false;
   }
 
   //--------------------------------------------------------------------------
@@ -196,8 +284,9 @@ public:
   //! \param depth The search depth used to obtain bestmove
   //! \param primaryFlag The primary HashEntry::Flag to assign to this entry
   //! \param otherFlags Or-ed set of additional entry flags
+  //! \return false if a deeper entry for the same position was kept instead
   //--------------------------------------------------------------------------
-  void Store(const uint64_t key,
+  bool Store(const uint64_t key,
              const Move& bestmove,
              const int depth,
              const int primaryFlag,
@@ -211,15 +300,24 @@ public:
            (primaryFlag == HashEntry::ExactScore));
     assert(!(otherFlags & ~HashEntry::OtherMask));
 
-    if (key && entries) { // TODO && (key != tt->key or depth >= tt->depth)
-      _stores++;
-      HashEntry* entry   = (entries + (key & keyMask));
-      entry->positionKey = key;
-      entry->moveBits    = bestmove.GetBits();
-      entry->score       = static_cast<int16_t>(bestmove.GetScore());
-      entry->depth       = static_cast<uint8_t>(depth);
-      entry->flags       = static_cast<uint8_t>(primaryFlag | otherFlags);
+    if (key && buckets) {
+      HashEntry* entry = Select(key);
+
+      // don't replace deeper results for the same position from this search
+      // unless we now have an exact score for it
+      const HashEntry old = *entry;
+      if ((primaryFlag != HashEntry::ExactScore) && (depth < old.depth) &&
+          ((old.flags & HashEntry::GenerationMask) == generation) &&
+          ((old.check ^ old.GetData()) == Check(key)))
+      {
+        return false;
+      }
+
+      Write(entry, key, bestmove.GetCompactBits(), bestmove.GetScore(), depth,
+            (primaryFlag | otherFlags));
+      return true;
     }
+    return false;
   }
 
   //--------------------------------------------------------------------------
@@ -227,14 +325,8 @@ public:
   //! \param key The position key
   //--------------------------------------------------------------------------
   void StoreCheckmate(const uint64_t key) {
-    if (key && entries) {
-      _checkmates++;
-      HashEntry* entry   = (entries + (key & keyMask));
-      entry->positionKey = key;
-      entry->moveBits    = 0;
-      entry->score       = Infinity;
-      entry->depth       = 0;
-      entry->flags       = HashEntry::Checkmate;
+    if (key && buckets) {
+      Write(Select(key), key, 0, Infinity, 0, HashEntry::Checkmate);
     }
   }
 
@@ -243,67 +335,282 @@ public:
   //! \param key The position key
   //--------------------------------------------------------------------------
   void StoreStalemate(const uint64_t key) {
-    if (key && entries) {
-      _stalemates++;
-      HashEntry* entry   = (entries + (key & keyMask));
-      entry->positionKey = key;
-      entry->moveBits    = 0;
-      entry->score       = 0;
-      entry->depth       = 0;
-      entry->flags       = HashEntry::Stalemate;
+    if (key && buckets) {
+      Write(Select(key), key, 0, 0, 0, HashEntry::Stalemate);
     }
   }
 
+private:
+  //--------------------------------------------------------------------------
+  //! How the table memory was obtained
+  //--------------------------------------------------------------------------
+  enum MemoryType {
+    NoMemory,
+    HeapMemory,   // posix_memalign or _aligned_malloc
+    HugeMemory,   // explicit huge pages: mmap with MAP_HUGETLB or
+                  // VirtualAlloc with MEM_LARGE_PAGES
+    FileMemory    // private mmap of a file written by Save()
+  };
+
   //--------------------------------------------------------------------------
-  //! Set all transposition table counters to zero
+  //! Allocate table memory, preferring huge pages
+  //! \param bytes The number of bytes to allocate
+  //! \return false if the memory could not be allocated
   //--------------------------------------------------------------------------
-  void ResetCounters() {
-    _stores = 0;
-    _hits = 0;
-    _checkmates = 0;
-    _stalemates = 0;
+  bool Allocate(const size_t bytes);
+
+  //--------------------------------------------------------------------------
+  //! Release table memory
+  //--------------------------------------------------------------------------
+  void Free();
+
+  //--------------------------------------------------------------------------
+  //! Clear the range of table memory described by a ClearRange object
+  //--------------------------------------------------------------------------
+  static void ClearRange(void* range);
+
+  //--------------------------------------------------------------------------
+  //! Select the entry to use for storing the given position key
+  //! An entry already holding the position is always selected.  Otherwise
+  //! the entry with the lowest depth, less 8 plies per generation of age,
+  //! is selected.  Unused entries are selected before all others.
+  //--------------------------------------------------------------------------
+  HashEntry* Select(const uint64_t key) {
+    const uint32_t check = Check(key);
+    HashBucket& bucket = buckets[key & keyMask];
+    HashEntry* best = bucket.entry;
+    int bestValue = 0x7FFFFFFF;
+    for (int i = 0; i < HashBucket::Size; ++i) {
+      HashEntry* entry = (bucket.entry + i);
+      const HashEntry tmp = *entry;
+      if ((tmp.check ^ tmp.GetData()) == check) {
+        return entry;
+      }
+      if (!tmp.flags) {
+        return entry;
+      }
+      const int age = (((generation - (tmp.flags & HashEntry::GenerationMask)) &
+                        HashEntry::GenerationMask) / HashEntry::GenerationInc);
+      const int value = (tmp.depth - (8 * age));
+      if (value < bestValue) {
+        bestValue = value;
+        best = entry;
+      }
+    }
+    return best;
   }
 
   //--------------------------------------------------------------------------
-  //! Get number of position+bestmove entries stored since last reset
-  //! \return The number of position+bestmove entries stored since last reset
+  //! Get the value used to verify an entry belongs to the given position key
   //--------------------------------------------------------------------------
-  uint64_t GetStores() const {
-    return _stores;
+  uint32_t Check(const uint64_t key) const {
+    return static_cast<uint32_t>((key ^ salt) >> 32);
   }
 
   //--------------------------------------------------------------------------
-  //! Get number of successful probes since last reset
-  //! \return The number of successful probes since last reset
+  //! Write a position into the given entry
   //--------------------------------------------------------------------------
-  uint64_t GetHits() const {
-    return _hits;
+  void Write(HashEntry* entry, const uint64_t key, const uint16_t move,
+             const int score, const int depth, const int flags)
+  {
+    HashEntry tmp;
+    tmp.move  = move;
+    tmp.score = static_cast<int16_t>(score);
+    tmp.depth = static_cast<uint8_t>(depth);
+    tmp.flags = static_cast<uint8_t>(flags | generation);
+    tmp.check = (Check(key) ^ tmp.GetData());
+    *entry = tmp;
+  }
+
+
+  size_t      keyMask;
+  uint64_t    salt;
+  int         generation;
+  size_t      memSize;
+  MemoryType  memType;
+  char*       memory;
+  HashBucket* buckets;
+};
+
+//----------------------------------------------------------------------------
+//! \brief Cache of static evaluation results
+//! A direct-mapped table of single 64-bit slots shared by all search threads.
+//! Each slot holds the high 32 bits of a position key, 16 bits of caller
+//! defined data, and a 16-bit evaluation score.  Slots are read and written
+//! with single 64-bit loads and stores, so no locking is needed.
+//----------------------------------------------------------------------------
+class EvalCache
+{
+public:
+  //--------------------------------------------------------------------------
+  //! Constructor
+  //--------------------------------------------------------------------------
+  EvalCache()
+    : keyMask(0),
+      slots(NULL)
+  { }
+
+  //--------------------------------------------------------------------------
+  //! Destructor
+  //--------------------------------------------------------------------------
+  ~EvalCache() {
+    delete[] slots;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Resize the cache, this also clears the contents of the cache
+  //! \param mbytes The maximum number of megabytes the cache will hold,
+  //!               zero disables the cache
+  //! \return false if the requested size could not be allocated
+  //--------------------------------------------------------------------------
+  bool Resize(const size_t mbytes);
+
+  //--------------------------------------------------------------------------
+  //! Clear contents of the cache
+  //--------------------------------------------------------------------------
+  void Clear() {
+    if (slots) {
+      memset(slots, 0, ((keyMask + 1) * sizeof(uint64_t)));
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Is the cache enabled?
+  //--------------------------------------------------------------------------
+  bool IsEnabled() const {
+    return (slots != NULL);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the cached evaluation for the given position key
+  //! \param key The position key
+  //! \param score Receives the cached score
+  //! \param data Receives the cached caller defined data
+  //! \return false if the position is not in the cache
+  //--------------------------------------------------------------------------
+  bool Probe(const uint64_t key, int& score, int& data) const {
+    const uint64_t slot = slots[key & keyMask];
+    if ((slot >> 32) != (key >> 32)) {
+      return false;
+    }
+    score = static_cast<int16_t>(slot & 0xFFFF);
+    data = static_cast<int>((slot >> 16) & 0xFFFF);
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Store the evaluation for the given position key
+  //! \param key The position key
+  //! \param score The score, must fit in 16 bits
+  //! \param data Caller defined data, must fit in 16 unsigned bits
+  //--------------------------------------------------------------------------
+  void Store(const uint64_t key, const int score, const int data) {
+    assert((score >= -0x8000) && (score <= 0x7FFF));
+    assert(!(data & ~0xFFFF));
+    slots[key & keyMask] = ((key & 0xFFFFFFFF00000000ULL) |
+                            (static_cast<uint64_t>(data) << 16) |
+                            static_cast<uint16_t>(score));
+  }
+
+private:
+  size_t    keyMask;
+  uint64_t* slots;
+};
+
+//----------------------------------------------------------------------------
+//! \brief Cache of perft leaf counts
+//! A direct-mapped table of (position key, depth) -> leaf count slots shared
+//! by all perft threads.  Each slot's check word is the depth-salted key
+//! XOR-ed with the count, so slots torn by concurrent writes fail
+//! verification instead of returning another position's count.
+//----------------------------------------------------------------------------
+class PerftTable
+{
+public:
+  //--------------------------------------------------------------------------
+  //! Constructor
+  //--------------------------------------------------------------------------
+  PerftTable()
+    : keyMask(0),
+      slots(NULL)
+  { }
+
+  //--------------------------------------------------------------------------
+  //! Destructor
+  //--------------------------------------------------------------------------
+  ~PerftTable() {
+    delete[] slots;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Resize the table, this also clears the contents of the table
+  //! \param mbytes The maximum number of megabytes the table will hold,
+  //!               zero disables the table
+  //! \return false if the requested size could not be allocated
+  //--------------------------------------------------------------------------
+  bool Resize(const size_t mbytes);
+
+  //--------------------------------------------------------------------------
+  //! Clear contents of the table
+  //--------------------------------------------------------------------------
+  void Clear() {
+    if (slots) {
+      memset(slots, 0, ((keyMask + 1) * sizeof(Slot)));
+    }
   }
 
   //--------------------------------------------------------------------------
-  //! Get the number of checkmates stored
-  //! \return The number of checkmates stored
+  //! Is the table enabled?
   //--------------------------------------------------------------------------
-  uint64_t GetCheckmates() const {
-    return _checkmates;
+  bool IsEnabled() const {
+    return (slots != NULL);
   }
 
   //--------------------------------------------------------------------------
-  //! Get the number of stalemates stored
-  //! \return The number of stalemates stored
+  //! Get the leaf count stored for the given position key and depth
+  //! \param key The position key
+  //! \param depth The perft depth the count was stored for
+  //! \param count Receives the leaf count
+  //! \return false if the position is not in the table at \p depth
+  //--------------------------------------------------------------------------
+  bool Probe(const uint64_t key, const int depth, uint64_t& count) const {
+    const uint64_t check = Check(key, depth);
+    const Slot slot = slots[check & keyMask];
+    if (!slot.check || ((slot.check ^ slot.count) != check)) {
+      return false;
+    }
+    count = slot.count;
+    return true;
+  }
+
   //--------------------------------------------------------------------------
-  uint64_t GetStalemates() const {
-    return _stalemates;
+  //! Store the leaf count for the given position key and depth
+  //! \param key The position key
+  //! \param depth The perft depth of \p count
+  //! \param count The number of leaf nodes below the position
+  //--------------------------------------------------------------------------
+  void Store(const uint64_t key, const int depth, const uint64_t count) {
+    const uint64_t check = Check(key, depth);
+    Slot& slot = slots[check & keyMask];
+    slot.check = (check ^ count);
+    slot.count = count;
   }
 
 private:
-  static uint64_t _stores;
-  static uint64_t _hits;
-  static uint64_t _checkmates;
-  static uint64_t _stalemates;
+  struct Slot {
+    uint64_t check; // Check() ^ count
+    uint64_t count; // leaf nodes below the position
+  };
+
+  //--------------------------------------------------------------------------
+  //! Fold the depth into the position key so each depth has its own slot
+  //--------------------------------------------------------------------------
+  static uint64_t Check(const uint64_t key, const int depth) {
+    return (key ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL));
+  }
 
-  size_t     keyMask;
-  HashEntry* entries;
+  size_t keyMask;
+  Slot*  slots;
 };
 
 } // namespace clubfoot
@@ -0,0 +1,182 @@
+//----------------------------------------------------------------------------
+// Copyright (c) 2015 Shawn Chidester <zd3nik@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//----------------------------------------------------------------------------
+
+#include "Material.h"
+
+namespace clubfoot
+{
+
+//----------------------------------------------------------------------------
+static const int PIECE_TYPES[] = { Pawn, Knight, Bishop, Rook, Queen };
+static const int PIECE_LIMIT[] = { 8,    2,      2,      2,    1     };
+
+//----------------------------------------------------------------------------
+void MaterialInfo::Init(const char count[14])
+{
+  int eval = 0;
+  int pc;
+
+  flags = 0;
+  scale = NoScale;
+
+  const int pieces[2] = {
+    (count[White|Knight] + count[White|Bishop] +
+     count[White|Rook] + count[White|Queen]),
+    (count[Black|Knight] + count[Black|Bishop] +
+     count[Black|Rook] + count[Black|Queen])
+  };
+
+  if (count[White|Pawn] ||
+      (count[White|Knight] > 2) ||
+      (count[White|Bishop] > 1) ||
+      (count[White|Knight] && count[White|Bishop]) ||
+      count[White|Rook] ||
+      count[White|Queen])
+  {
+    flags |= WhiteCanWin;
+  }
+
+  if (count[Black|Pawn] ||
+      (count[Black|Knight] > 2) ||
+      (count[Black|Bishop] > 1) ||
+      (count[Black|Knight] && count[Black|Bishop]) ||
+      count[Black|Rook] ||
+      count[Black|Queen])
+  {
+    flags |= BlackCanWin;
+  }
+
+  // redundant knights are worth slightly less
+  if (count[White|Knight] > 1) {
+    eval -= (16 * (count[White|Knight] - 1));
+  }
+  if (count[Black|Knight] > 1) {
+    eval += (16 * (count[Black|Knight] - 1));
+  }
+
+  // no pawns is bad
+  if (!count[White|Pawn]) {
+    eval -= 50;
+  }
+  if (!count[Black|Pawn]) {
+    eval += 50;
+  }
+
+  // are there any pawns on the board?
+  if ((pc = (count[White|Pawn] + count[Black|Pawn]))) {
+    // increase value of 1 knight relative to # of pawns on the board
+    pc = ((4 * pc) / 3); // inflate pawn count a little bit
+    assert(pc <= 21);
+    if (count[White|Knight]) {
+      eval += pc;
+    }
+    if (count[Black|Knight]) {
+      eval -= pc;
+    }
+
+    // increase value of 1 rook as pawns come off the board
+    pc = ((4 * pc) / 3); // inflate pawn count a bit more
+    assert(pc <= 28);
+    if (count[White|Rook]) {
+      eval += (28 - pc);
+    }
+    if (count[Black|Rook]) {
+      eval -= (28 - pc);
+    }
+
+    // bishop pair more valuable as pawns come off the board
+    // NOTE: this doesn't verify the bishops are on opposite color squares!
+    if (count[White|Bishop] >= 2) {
+      eval += (48 - pc);
+    }
+    if (count[Black|Bishop] >= 2) {
+      eval -= (48 - pc);
+    }
+
+    // pawns + R vs R ending
+    if ((pieces[White] == 1) && count[White|Rook] &&
+        (pieces[Black] == 1) && count[Black|Rook])
+    {
+      scale = RookVsRook;
+    }
+  }
+
+  // Q vs R
+  else if ((pieces[White] == 1) && (pieces[Black] == 1) &&
+           ((count[White|Queen] && count[Black|Rook]) ||
+            (count[Black|Queen] && count[White|Rook])))
+  {
+    scale = QueenVsRook;
+  }
+
+  // R vs minor(s)
+  else if (((pieces[White] == 1) && (count[White|Rook] == 1) &&
+            (pieces[Black] <= 2) &&
+            !count[Black|Rook] && !count[Black|Queen]) ||
+           ((pieces[Black] == 1) && (count[Black|Rook] == 1) &&
+            (pieces[White] <= 2) &&
+            !count[White|Rook] && !count[White|Queen]))
+  {
+    scale = RookVsMinors;
+  }
+
+  score = static_cast<int16_t>(eval);
+}
+
+//----------------------------------------------------------------------------
+MaterialTable::MaterialTable()
+{
+  char count[14];
+  for (uint32_t key = 0; key < Size; ++key) {
+    uint32_t remain = key;
+    memset(count, 0, sizeof(count));
+    for (int color = White; color <= Black; ++color) {
+      for (int i = 0; i < 5; ++i) {
+        const uint32_t radix = (PIECE_LIMIT[i] + 1);
+        count[color|PIECE_TYPES[i]] = static_cast<char>(remain % radix);
+        remain /= radix;
+      }
+    }
+    assert(!remain);
+    assert(GetKey(count) == key);
+    info[key].Init(count);
+  }
+}
+
+//----------------------------------------------------------------------------
+uint32_t MaterialTable::GetKey(const char count[14])
+{
+  uint32_t key = 0;
+  for (int color = White; color <= Black; ++color) {
+    for (int i = 0; i < 5; ++i) {
+      const int pc = (color|PIECE_TYPES[i]);
+      assert(count[pc] >= 0);
+      if (count[pc] > PIECE_LIMIT[i]) {
+        key |= Overflow;
+      }
+      key += (count[pc] * WeightOf(pc));
+    }
+  }
+  return key;
+}
+
+} // namespace clubfoot
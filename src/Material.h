@@ -0,0 +1,143 @@
+//----------------------------------------------------------------------------
+// Copyright (c) 2015 Shawn Chidester <zd3nik@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//----------------------------------------------------------------------------
+
+#ifndef CLUBFOOT_MATERIAL_H
+#define CLUBFOOT_MATERIAL_H
+
+#include "senjo/src/Platform.h"
+#include "Types.h"
+
+namespace clubfoot
+{
+
+//----------------------------------------------------------------------------
+//! \brief Evaluation terms that depend only on piece counts
+//----------------------------------------------------------------------------
+struct MaterialInfo
+{
+  enum Flag {
+    WhiteCanWin = 0x01,
+    BlackCanWin = 0x02
+  };
+
+  enum Scale {
+    NoScale,      // no endgame specific scaling
+    QueenVsRook,  // lone queen vs lone rook, no pawns
+    RookVsMinors, // lone rook vs up to 2 minor pieces, no pawns
+    RookVsRook    // lone rook vs lone rook, with pawns
+  };
+
+  //--------------------------------------------------------------------------
+  //! Calculate material terms for the given piece counts
+  //! \param count Number of pieces per piece type, indexed by (color|type)
+  //--------------------------------------------------------------------------
+  void Init(const char count[14]);
+
+  int16_t score; // material imbalance score from white's perspective
+  uint8_t flags; // combination of Flag values
+  uint8_t scale; // one of Scale values
+};
+
+static_assert(sizeof(MaterialInfo) == 4, "MaterialInfo must be 4 bytes");
+
+//----------------------------------------------------------------------------
+//! \brief Table of MaterialInfo for every common material configuration
+//! A material key is the sum of (piece count * piece weight) for every piece
+//! type, where the weights form a mixed radix number that allows up to 8
+//! pawns, 2 knights, 2 bishops, 2 rooks and 1 queen per side.  Keys are
+//! updated incrementally by adding or subtracting piece weights.  Promoting
+//! to a piece type beyond its limit sets the Overflow bit, which stays set
+//! for the rest of that line of play.  Overflowed keys are not in the table.
+//----------------------------------------------------------------------------
+class MaterialTable
+{
+public:
+  enum {
+    Overflow = 0x1000000,
+    Size     = (9 * 3 * 3 * 3 * 2 * 9 * 3 * 3 * 3 * 2)
+  };
+
+  //--------------------------------------------------------------------------
+  //! Constructor, populates the table
+  //--------------------------------------------------------------------------
+  MaterialTable();
+
+  //--------------------------------------------------------------------------
+  //! Get the material key weight of a given piece type
+  //--------------------------------------------------------------------------
+  static inline uint32_t WeightOf(const int piece) {
+    static const uint32_t WEIGHT[] = {
+      0,   0,
+      1,   486,
+      9,   4374,
+      27,  13122,
+      81,  39366,
+      243, 118098,
+      0,   0
+    };
+    assert(piece >= 0);
+    assert(piece <= (Black|King));
+    return WEIGHT[piece];
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get the material key for the given piece counts
+  //! \param count Number of pieces per piece type, indexed by (color|type)
+  //--------------------------------------------------------------------------
+  static uint32_t GetKey(const char count[14]);
+
+  //--------------------------------------------------------------------------
+  //! Get the material key after promoting a pawn to the given piece type
+  //! \param key The material key before the promotion
+  //! \param promo The piece type the pawn is promoted to
+  //--------------------------------------------------------------------------
+  static inline uint32_t Promote(const uint32_t key, const int promo) {
+    const uint32_t radix = (((promo & ~ColorMask) == Queen) ? 2 : 3);
+    const uint32_t result = (key - WeightOf(COLOR_OF(promo)|Pawn) +
+                             WeightOf(promo));
+    if (!(key & Overflow) &&
+        (((key / WeightOf(promo)) % radix) == (radix - 1)))
+    {
+      return (result | Overflow);
+    }
+    return result;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Get material info for the given key
+  //! \return NULL if the key has overflowed
+  //--------------------------------------------------------------------------
+  inline const MaterialInfo* Probe(const uint32_t key) const {
+    if (key & Overflow) {
+      return NULL;
+    }
+    assert(key < Size);
+    return (info + key);
+  }
+
+private:
+  MaterialInfo info[Size];
+};
+
+} // namespace clubfoot
+
+#endif // CLUBFOOT_MATERIAL_H
@@ -0,0 +1,368 @@
+//----------------------------------------------------------------------------
+// Copyright (c) 2015 Shawn Chidester <zd3nik@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//----------------------------------------------------------------------------
+
+#include "ClubFoot.h"
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace clubfoot
+{
+
+//----------------------------------------------------------------------------
+//! \brief Times ClubFoot hot path kernels in isolation
+//! Each kernel is run over every position of a corpus loaded from EPD files.
+//! One repetition is a pass over the whole corpus, running the kernel
+//! 'loops' times per position.  Only the kernel is timed, not SetPosition().
+//! Warmup repetitions are run first and discarded, the rest are reported as
+//! mean nanoseconds per operation with standard deviation and minimum.
+//----------------------------------------------------------------------------
+class MicroBench
+{
+public:
+  MicroBench(const int reps, const int warmup, const int loops)
+    : reps(reps),
+      warmup(warmup),
+      loops(loops),
+      sink(0)
+  { }
+
+  //--------------------------------------------------------------------------
+  //! Initialize the engine, the eval cache is disabled so Evaluate()
+  //! measures a full static evaluation every time
+  //--------------------------------------------------------------------------
+  void Init() {
+    engine.SetEngineOption("Hash", "16");
+    engine.SetEngineOption("Eval Cache", "0");
+    engine.Initialize();
+  }
+
+  //--------------------------------------------------------------------------
+  //! Add the positions in an EPD file to the corpus
+  //! \return Number of positions added
+  //--------------------------------------------------------------------------
+  size_t LoadPositions(const char* fileName) {
+    FILE* fp = fopen(fileName, "r");
+    if (!fp) {
+      fprintf(stderr, "Cannot open '%s': %s\n", fileName, strerror(errno));
+      return 0;
+    }
+
+    size_t count = 0;
+    char line[16384];
+    while (fgets(line, sizeof(line), fp)) {
+      char* fen = line;
+      if (!*senjo::NormalizeString(fen) || (*fen == '#')) {
+        continue;
+      }
+      if (!engine.SetPosition(fen)) {
+        continue;
+      }
+      positions.push_back(engine.GetFEN());
+      count++;
+    }
+    fclose(fp);
+    return count;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Run all kernels and print a line of results for each
+  //--------------------------------------------------------------------------
+  void Run() {
+    printf("%zu positions, %d loops per position, %d warmup, %d reps\n",
+           positions.size(), loops, warmup, reps);
+    printf("%-16s %12s %10s %8s %10s\n",
+           "kernel", "ops/rep", "ns/op", "stddev", "min");
+
+    Time("GenerateMoves",  &MicroBench::GenerateMoves);
+    Time("Exec/Undo",      &MicroBench::ExecUndo, &MicroBench::PrepareMoves);
+    Time("Evaluate",       &MicroBench::Evaluate);
+    Time("StaticExchange", &MicroBench::StaticExchange);
+    Time("AttackedBy",     &MicroBench::AttackedBy);
+    Time("TT Probe",       &MicroBench::Probe, &MicroBench::PrepareProbe);
+
+    // keeps the compiler from discarding kernel results
+    if (sink == 42) {
+      printf("\n");
+    }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  //! Run kernel on the current position, return number of operations done
+  typedef uint64_t (MicroBench::*Kernel)();
+
+  //! Untimed per-position setup for a kernel
+  typedef void (MicroBench::*Setup)();
+
+  //--------------------------------------------------------------------------
+  //! Time one kernel over the corpus and print the results
+  //--------------------------------------------------------------------------
+  void Time(const char* name, Kernel kernel, Setup setup = NULL) {
+    std::vector<double> samples;
+    uint64_t ops = 0;
+    for (int rep = 0; rep < (warmup + reps); ++rep) {
+      Clock::duration elapsed(0);
+      ops = 0;
+      for (size_t i = 0; i < positions.size(); ++i) {
+        engine.SetPosition(positions[i].c_str());
+        if (setup) {
+          (this->*setup)();
+        }
+        const Clock::time_point start = Clock::now();
+        for (int n = 0; n < loops; ++n) {
+          ops += (this->*kernel)();
+        }
+        elapsed += (Clock::now() - start);
+      }
+      if ((rep >= warmup) && ops) {
+        const double ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+            .count());
+        samples.push_back(ns / ops);
+      }
+    }
+
+    double mean = 0;
+    double min = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      mean += samples[i];
+      if (!i || (samples[i] < min)) {
+        min = samples[i];
+      }
+    }
+    mean = (samples.empty() ? 0 : (mean / samples.size()));
+
+    double variance = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      variance += ((samples[i] - mean) * (samples[i] - mean));
+    }
+    if (samples.size() > 1) {
+      variance /= (samples.size() - 1);
+    }
+
+    printf("%-16s %12llu %10.2f %7.2f%% %10.2f\n", name,
+           static_cast<unsigned long long>(ops), mean,
+           (mean ? (100 * sqrt(variance) / mean) : 0), min);
+  }
+
+  //--------------------------------------------------------------------------
+  //! Generate all legal moves
+  //--------------------------------------------------------------------------
+  uint64_t GenerateMoves() {
+    if (engine.WhiteToMove()) {
+      engine.GenerateMoves<White, false>(0);
+    }
+    else {
+      engine.GenerateMoves<Black, false>(0);
+    }
+    sink += engine.moveCount;
+    return 1;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Generate the moves ExecUndo() executes
+  //--------------------------------------------------------------------------
+  void PrepareMoves() {
+    if (engine.WhiteToMove()) {
+      engine.GenerateMoves<White, false>(0);
+    }
+    else {
+      engine.GenerateMoves<Black, false>(0);
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Execute and undo every legal move, child evaluation is deferred
+  //--------------------------------------------------------------------------
+  template<Color color>
+  uint64_t ExecUndo() {
+    for (int i = 0; i < engine.moveCount; ++i) {
+      engine.Exec<color>(engine.moves[i], *engine.child, true);
+      sink += engine.child->positionKey;
+      engine.Undo<color>(engine.moves[i]);
+    }
+    return static_cast<uint64_t>(engine.moveCount);
+  }
+
+  uint64_t ExecUndo() {
+    return engine.WhiteToMove() ? ExecUndo<White>() : ExecUndo<Black>();
+  }
+
+  //--------------------------------------------------------------------------
+  //! Full static evaluation of the position
+  //--------------------------------------------------------------------------
+  uint64_t Evaluate() {
+    engine.Evaluate();
+    sink += static_cast<uint64_t>(engine.standPat);
+    return 1;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Exchange value of every enemy piece (other than the king) the side to
+  //! move attacks
+  //--------------------------------------------------------------------------
+  template<Color color>
+  uint64_t StaticExchange() {
+    uint64_t ops = 0;
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        const senjo::Square sqr(x, y);
+        const int piece = engine.board[sqr.Name()];
+        if (piece && (piece < King) && (COLOR_OF(piece) != color) &&
+            engine.AttackedBy<color>(sqr))
+        {
+          sink += static_cast<uint64_t>(engine.StaticExchange<color>(sqr));
+          ops++;
+        }
+      }
+    }
+    return ops;
+  }
+
+  uint64_t StaticExchange() {
+    return engine.WhiteToMove() ? StaticExchange<White>()
+                                : StaticExchange<Black>();
+  }
+
+  //--------------------------------------------------------------------------
+  //! Is each square attacked by white, by black?
+  //--------------------------------------------------------------------------
+  uint64_t AttackedBy() {
+    for (int y = 0; y < 8; ++y) {
+      for (int x = 0; x < 8; ++x) {
+        const senjo::Square sqr(x, y);
+        sink += engine.AttackedBy<White>(sqr);
+        sink += engine.AttackedBy<Black>(sqr);
+      }
+    }
+    return 128;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Store the position keys of every other child of the current position
+  //! in the transposition table so Probe() sees a mix of hits and misses
+  //--------------------------------------------------------------------------
+  void PrepareProbe() {
+    keys.clear();
+    if (engine.WhiteToMove()) {
+      PrepareProbe<White>();
+    }
+    else {
+      PrepareProbe<Black>();
+    }
+  }
+
+  template<Color color>
+  void PrepareProbe() {
+    engine.GenerateMoves<color, false>(0);
+    for (int i = 0; i < engine.moveCount; ++i) {
+      Move& move = engine.moves[i];
+      engine.Exec<color>(move, *engine.child, true);
+      keys.push_back(engine.child->positionKey);
+      engine.Undo<color>(move);
+      if (i & 1) {
+        move.Score() = 0;
+        engine.td->tt->Store(keys.back(), move, 1, HashEntry::ExactScore, 0);
+      }
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  //! Probe the transposition table for each child position key
+  //--------------------------------------------------------------------------
+  uint64_t Probe() {
+    HashEntry entry;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (engine.td->tt->Probe(keys[i], entry)) {
+        sink += entry.GetData();
+      }
+    }
+    return static_cast<uint64_t>(keys.size());
+  }
+
+  const int                reps;
+  const int                warmup;
+  const int                loops;
+  uint64_t                 sink;
+  ClubFoot                 engine;
+  std::vector<std::string> positions;
+  std::vector<uint64_t>    keys;
+};
+
+} // namespace clubfoot
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  int reps = 10;
+  int warmup = 2;
+  int loops = 100;
+  std::vector<const char*> files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-r") && ((i + 1) < argc)) {
+      reps = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-w") && ((i + 1) < argc)) {
+      warmup = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-n") && ((i + 1) < argc)) {
+      loops = atoi(argv[++i]);
+    }
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [-r reps] [-w warmup] [-n loops] "
+              "[epd file ...]\n", argv[0]);
+      return 1;
+    }
+    else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.empty()) {
+    files.push_back("epd/wac.epd");
+    files.push_back("epd/perftsuite.epd");
+  }
+  if ((reps < 1) || (warmup < 0) || (loops < 1)) {
+    fprintf(stderr, "reps and loops must be positive, warmup not negative\n");
+    return 1;
+  }
+
+  clubfoot::MicroBench bench(reps, warmup, loops);
+  bench.Init();
+  size_t count = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    count += bench.LoadPositions(files[i]);
+  }
+  if (!count) {
+    fprintf(stderr, "No positions loaded\n");
+    return 1;
+  }
+
+  bench.Run();
+  return 0;
+}
@@ -57,6 +57,12 @@ public:
     PromoShift  = 28  ///< Number of bits the 'promo' value is shifted left
   };
 
+  //--------------------------------------------------------------------------
+  enum Masks {
+    SquareMask  = 0x77, ///< Bits of the 'from' and 'to' values used by squares
+    CheckFlag   = (0x80 << FromShift) ///< Set if this move gives check
+  };
+
   //--------------------------------------------------------------------------
   //! \brief Compare two moves lexically
   //! \param a The left move
@@ -174,6 +180,50 @@ public:
     return bits;
   }
 
+  //--------------------------------------------------------------------------
+  //! \brief Get the 16 bit compact form of this move
+  //! Only the source and destination squares (6 bits each) and the promotion
+  //! piece type (2 bits) are kept, everything else can be derived from the
+  //! position the move is made in.
+  //! \return The 16 bit compact form of this move
+  //--------------------------------------------------------------------------
+  uint16_t GetCompactBits() const {
+    const int from  = GetFromName();
+    const int to    = GetToName();
+    const int promo = GetPromo();
+    return static_cast<uint16_t>(
+        (((from & 0x70) >> 1) | (from & 7))        |
+        ((((to & 0x70) >> 1) | (to & 7)) << 6)     |
+        ((promo ? (((promo >> 1) - 2) & 3) : 0) << 12));
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Get the source square name from a compact move
+  //! \param compact The 16 bit compact form of a move
+  //! \return The source square name
+  //--------------------------------------------------------------------------
+  static int CompactFrom(const int compact) {
+    return (((compact & 0x38) << 1) | (compact & 7));
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Get the destination square name from a compact move
+  //! \param compact The 16 bit compact form of a move
+  //! \return The destination square name
+  //--------------------------------------------------------------------------
+  static int CompactTo(const int compact) {
+    return ((((compact >> 6) & 0x38) << 1) | ((compact >> 6) & 7));
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Get the promotion piece type (without color) from a compact move
+  //! \param compact The 16 bit compact form of a move
+  //! \return Knight, Bishop, Rook, or Queen (only meaningful for promotions)
+  //--------------------------------------------------------------------------
+  static int CompactPromo(const int compact) {
+    return ((((compact >> 12) & 3) + 2) << 1);
+  }
+
   //--------------------------------------------------------------------------
   //! \brief Get the type of this move
   //! \return The move type
@@ -219,7 +269,7 @@ public:
   //! \return The source square name
   //--------------------------------------------------------------------------
   int GetFromName() const {
-    return static_cast<int>((bits >> FromShift) & EightBits);
+    return static_cast<int>((bits >> FromShift) & SquareMask);
   }
 
   //--------------------------------------------------------------------------
@@ -235,7 +285,7 @@ public:
   //! \return The destination square name
   //--------------------------------------------------------------------------
   int GetToName() const {
-    return static_cast<int>((bits >> ToShift) & EightBits);
+    return static_cast<int>((bits >> ToShift) & SquareMask);
   }
 
   //--------------------------------------------------------------------------
@@ -246,6 +296,21 @@ public:
     return (GetType() && (GetFromName() != GetToName()));
   }
 
+  //--------------------------------------------------------------------------
+  //! \brief Does this move put the enemy king in check?
+  //! \return true if this move was flagged with SetGivesCheck()
+  //--------------------------------------------------------------------------
+  bool GivesCheck() const {
+    return (bits & CheckFlag);
+  }
+
+  //--------------------------------------------------------------------------
+  //! \brief Flag this move as one that puts the enemy king in check
+  //--------------------------------------------------------------------------
+  void SetGivesCheck() {
+    bits |= CheckFlag;
+  }
+
   //--------------------------------------------------------------------------
   //! \brief Does this move capture a piece or promote a pawn?
   //! \return true if this move captures a piece or promotes a pawn
@@ -259,15 +324,16 @@ public:
   //! \return The history array index for this move
   //--------------------------------------------------------------------------
   int GetHistoryIndex() const {
-    return ((bits >> FromShift) & 0xFFFFF);
+    return (((bits & ~CheckFlag) >> FromShift) & 0xFFFFF);
   }
 
   //--------------------------------------------------------------------------
   //! \brief Equality comparision operator
+  //! The check flag is ignored so moves from different sources compare equal
   //! \return true if this move is the same as \p other
   //--------------------------------------------------------------------------
   bool operator==(const Move& other) const {
-    return (bits && (bits == other.bits));
+    return (bits && !((bits ^ other.bits) & ~CheckFlag));
   }
 
   //--------------------------------------------------------------------------
@@ -275,7 +341,7 @@ public:
   //! \return true if this move is not the same as \p other
   //--------------------------------------------------------------------------
   bool operator!=(const Move& other) const {
-    return (!bits || (bits != other.bits));
+    return (!bits || ((bits ^ other.bits) & ~CheckFlag));
   }
 
   //--------------------------------------------------------------------------
@@ -56,6 +56,13 @@ void Stats::Clear()
   lmResearches  = 0;
   lmConfirmed   = 0;
   lmAlphaIncs   = 0;
+  evalLookups   = 0;
+  evalHits      = 0;
+  lazyEvals     = 0;
+  hashHits      = 0;
+  hashStores    = 0;
+  checkmates    = 0;
+  stalemates    = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -85,6 +92,13 @@ Stats& Stats::operator+=(const Stats& other) {
   lmResearches  += other.lmResearches;
   lmConfirmed   += other.lmConfirmed;
   lmAlphaIncs   += other.lmAlphaIncs;
+  evalLookups   += other.evalLookups;
+  evalHits      += other.evalHits;
+  lazyEvals     += other.lazyEvals;
+  hashHits      += other.hashHits;
+  hashStores    += other.hashStores;
+  checkmates    += other.checkmates;
+  stalemates    += other.stalemates;
   return *this;
 }
 
@@ -123,11 +137,22 @@ Stats Stats::Average() const {
   avg.lmResearches  = Avg(lmResearches, statCount);
   avg.lmConfirmed   = Avg(lmConfirmed,  statCount);
   avg.lmAlphaIncs   = Avg(lmAlphaIncs,  statCount);
+  avg.evalLookups   = Avg(evalLookups,  statCount);
+  avg.evalHits      = Avg(evalHits,     statCount);
+  avg.lazyEvals     = Avg(lazyEvals,    statCount);
+  avg.hashHits      = Avg(hashHits,     statCount);
+  avg.hashStores    = Avg(hashStores,   statCount);
+  avg.checkmates    = Avg(checkmates,   statCount);
+  avg.stalemates    = Avg(stalemates,   statCount);
   return avg;
 }
 
 //----------------------------------------------------------------------------
 void Stats::Print() {
+  Output() << hashStores << " stores, " << hashHits << " hits, "
+           << checkmates << " checkmates, "
+           << stalemates << " stalemates";
+
   if (chkExts || oneReplyExts || hashExts) {
     Output() << chkExts << " check extensions, "
              << oneReplyExts << " one reply extensions, "
@@ -146,6 +171,11 @@ void Stats::Print() {
              << Percent(deltaCount, qnodes) << "%)";
   }
 
+  if (lazyEvals) {
+    Output() << lazyEvals << " lazy evals ("
+             << Percent(lazyEvals, qnodes) << "% of qnodes)";
+  }
+
   if (rzrCount) {
     Output() << rzrCount << " razor attempts, "
              << rzrEarlyOut << " early out ("
@@ -191,6 +221,12 @@ void Stats::Print() {
              << lmConfirmed << " confirmed ("
              << Percent(lmConfirmed, lmResearches) << "%)";
   }
+
+  if (evalLookups) {
+    Output() << evalLookups << " eval cache lookups, "
+             << evalHits << " hits ("
+             << Percent(evalHits, evalLookups) << "%)";
+  }
 }
 
 } // namespace clubfoot
@@ -61,6 +61,13 @@ struct Stats
   uint64_t lmResearches;  // lmReductions re-searched at full depth
   uint64_t lmConfirmed;   // lmResearches alpha increases confirmed
   uint64_t lmAlphaIncs;   // late moves that increase alpha
+  uint64_t evalLookups;   // eval cache lookups
+  uint64_t evalHits;      // eval cache hits
+  uint64_t lazyEvals;     // full evaluations skipped by LazyEval()
+  uint64_t hashHits;      // successful transposition table probes
+  uint64_t hashStores;    // position+bestmove entries stored
+  uint64_t checkmates;    // checkmates stored
+  uint64_t stalemates;    // stalemates stored
   uint64_t statCount;     // number of stats summed into this instance
 };
 
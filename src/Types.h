@@ -96,7 +96,8 @@ enum CheckState {
 enum MoveGenType {
   AllMoves,
   CapsAndChecks,
-  Captures
+  Captures,
+  QuietMoves
 };
 
 } // namespace clubfoot